@@ -0,0 +1,173 @@
+/**
+ * Benchmark comparing the serial and the multi-threaded update passes of
+ * SEEDS Revised.
+ * 
+ * **How to use the benchmark?**
+ * 
+ * The benchmark is built alongside the command line tool. Each image in the given
+ * folder is segmented once using a single thread and once using the given number
+ * of threads; wall clock times and the resulting speedup are reported:
+ * 
+ *  $ ./bin/reseeds_benchmark --help
+ *  Allowed options:
+ *   --help                          produce help message
+ *   --input arg                     the folder to process, may contain several 
+ *                                   images
+ *   --bins arg (=5)                 number of bins used for color histograms
+ *   --neighborhood arg (=1)         neighborhood size used for smoothing prior
+ *   --confidence arg (=0.100000001) minimum confidence used for block update
+ *   --iterations arg (=2)           iterations at each level
+ *   --spatial-weight arg (=0.25)    spatial weight
+ *   --superpixels arg (=400)        desired number of superpixels
+ *   --threads arg (=4)              number of threads to compare against one 
+ *                                   thread
+ *   --repetitions arg (=3)          repetitions per image, the fastest run 
+ *                                   is reported
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "SeedsRevised.h"
+#include <opencv2/opencv.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+/**
+ * Segment the image using the given number of threads and return the fastest
+ * wall clock time in seconds over the given number of repetitions. Note that
+ * boost::timer measures processor time and is therefore not suited here.
+ */
+double timeSegmentation(const cv::Mat &image, int superpixels, int numberOfBins, 
+        int neighborhoodSize, float minimumConfidence, float spatialWeight,
+        int iterations, int threads, int repetitions) {
+    
+    double best = -1;
+    for (int r = 0; r < repetitions; ++r) {
+        SEEDSRevisedMeanPixels seeds(image, superpixels, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, SEEDSRevised::BGR);
+        seeds.setNumberOfThreads(threads);
+        
+        int64 start = cv::getTickCount();
+        seeds.initialize();
+        seeds.iterate(iterations);
+        double elapsed = (cv::getTickCount() - start)/cv::getTickFrequency();
+        
+        if (best < 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    
+    return best;
+}
+
+int main(int argc, const char** argv) {
+    
+    boost::program_options::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "produce help message")
+        ("input", boost::program_options::value<std::string>(), "the folder to process, may contain several images")
+        ("bins", boost::program_options::value<int>()->default_value(5), "number of bins used for color histograms")
+        ("neighborhood", boost::program_options::value<int>()->default_value(1), "neighborhood size used for smoothing prior")
+        ("confidence", boost::program_options::value<float>()->default_value(0.1), "minimum confidence used for block update")
+        ("iterations", boost::program_options::value<int>()->default_value(2), "iterations at each level")
+        ("spatial-weight", boost::program_options::value<float>()->default_value(0.25), "spatial weight")
+        ("superpixels", boost::program_options::value<int>()->default_value(400), "desired number of superpixels")
+        ("threads", boost::program_options::value<int>()->default_value(4), "number of threads to compare against one thread")
+        ("repetitions", boost::program_options::value<int>()->default_value(3), "repetitions per image, the fastest run is reported");
+
+    boost::program_options::positional_options_description positionals;
+    positionals.add("input", 1);
+    
+    boost::program_options::variables_map parameters;
+    boost::program_options::store(boost::program_options::command_line_parser(argc, argv).options(desc).positional(positionals).run(), parameters);
+    boost::program_options::notify(parameters);
+
+    if (parameters.find("help") != parameters.end() || parameters.find("input") == parameters.end()) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+    
+    boost::filesystem::path inputDir(parameters["input"].as<std::string>());
+    if (!boost::filesystem::is_directory(inputDir)) {
+        std::cout << "Input directory not found ..." << std::endl;
+        return 1;
+    }
+    
+    std::vector<boost::filesystem::path> pathVector;
+    std::vector<boost::filesystem::path> images;
+    
+    std::copy(boost::filesystem::directory_iterator(inputDir), boost::filesystem::directory_iterator(), std::back_inserter(pathVector));
+    std::sort(pathVector.begin(), pathVector.end());
+    
+    std::string extension;
+    for (std::vector<boost::filesystem::path>::const_iterator iterator(pathVector.begin()); iterator != pathVector.end(); ++iterator) {
+        if (boost::filesystem::is_regular_file(*iterator)) {
+            extension = iterator->extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            
+            if (extension == ".png" || extension == ".jpg" || extension == ".jpeg") {
+                images.push_back(*iterator);
+            }
+        }
+    }
+    
+    int iterations = parameters["iterations"].as<int>();
+    int numberOfBins = parameters["bins"].as<int>();
+    int neighborhoodSize = parameters["neighborhood"].as<int>();
+    float minimumConfidence = parameters["confidence"].as<float>();
+    float spatialWeight = parameters["spatial-weight"].as<float>();
+    int superpixels = parameters["superpixels"].as<int>();
+    int threads = parameters["threads"].as<int>();
+    int repetitions = std::max(1, parameters["repetitions"].as<int>());
+    
+    double totalSerial = 0;
+    double totalParallel = 0;
+    
+    for (std::vector<boost::filesystem::path>::iterator iterator = images.begin(); iterator != images.end(); ++iterator) {
+        cv::Mat image = cv::imread(iterator->string());
+        
+        double serial = timeSegmentation(image, superpixels, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, iterations, 1, repetitions);
+        double parallel = timeSegmentation(image, superpixels, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, iterations, threads, repetitions);
+        
+        totalSerial += serial;
+        totalParallel += parallel;
+        
+        std::cout << iterator->string() << " (" << image.cols << "x" << image.rows << "): " 
+                << serial << "s serial, " << parallel << "s with " << threads << " threads, speedup " 
+                << serial/parallel << " ..." << std::endl;
+    }
+    
+    if (images.size() > 0) {
+        std::cout << "On average, " << totalSerial/images.size() << " seconds serial and " 
+                << totalParallel/images.size() << " seconds with " << threads << " threads, speedup " 
+                << totalSerial/totalParallel << " ..." << std::endl;
+    }
+    
+    return 0;
+}
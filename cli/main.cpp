@@ -29,6 +29,29 @@
  *   --iterations arg (=2)           iterations at each level
  *   --spatial-weight arg (=0.25)    spatial weight
  *   --superpixels arg (=400)        desired number of supüerpixels
+ *   --threads arg (=1)              number of threads used for block and pixel updates
+ *   --sparse                        store the histograms of small blocks sparsely,
+ *                                   faster for large --bins
+ *   --uniform                       bin the color channels uniformly instead of
+ *                                   using equally filled bins
+ *   --memory arg (=plain)           spatial memory used for block and pixel
+ *                                   updates: none, plain or heuristic
+ *   --warm-start                    treat the images as consecutive video frames and
+ *                                   start from the segmentation of the previous frame
+ *   --scene-cut arg (=0.5)          minimum similarity between consecutive frames used
+ *                                   for --warm-start, below a scene cut is assumed
+ *   --minimum-change arg (=0)       fraction of blocks or pixels to be moved in an
+ *                                   iteration to continue at the current level
+ *   --time-budget arg (=0)          maximum time in seconds for the iterations on
+ *                                   each image, 0 for no limit
+ *   --tile-size arg (=0)            segment large images in tiles of at least this
+ *                                   size, using --threads tiles in parallel, 0 to
+ *                                   disable; ignores --warm-start, --minimum-change
+ *                                   and --time-budget
+ *   --tile-overlap arg (=32)        number of pixels by which the tiles overlap on
+ *                                   each side, used to stitch superpixels across tiles
+ *   --jobs arg (=1)                 number of images segmented concurrently, images
+ *                                   are read and written in separate threads
  *   --verbose                       show additional information while processing
  *   --csv                           save segmentation as CSV file
  *   --contour                       save contour image of segmentation
@@ -68,11 +91,13 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "SeedsRevised.h"
+#include "SeedsRevisedTiled.h"
 #include "Tools.h"
 #include <opencv2/opencv.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/timer.hpp>
 #include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <deque>
 
 #if defined(WIN32) || defined(_WIN32)
     #define DIRECTORY_SEPARATOR "\\"
@@ -80,6 +105,308 @@
     #define DIRECTORY_SEPARATOR "/"
 #endif
 
+/**
+ * Queue of fixed capacity shared between the stages of the pipeline: push blocks
+ * while the queue is full such that only a bounded number of images is kept in
+ * memory, pop blocks while the queue is empty and has not been closed.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * Constructor.
+     * 
+     * @param int capacity
+     */
+    BoundedQueue(int capacity) : capacity(capacity), closed(false) {
+        assert(capacity > 0);
+    }
+    
+    /**
+     * Add an item, blocks while the queue is full.
+     * 
+     * @param T item
+     */
+    void push(const T &item) {
+        boost::unique_lock<boost::mutex> lock(this->mutex);
+        while ((int) this->items.size() >= this->capacity) {
+            this->notFull.wait(lock);
+        }
+        
+        this->items.push_back(item);
+        this->notEmpty.notify_one();
+    }
+    
+    /**
+     * Remove the next item, blocks while the queue is empty.
+     * 
+     * @param T item
+     * @return bool false if the queue is empty and has been closed
+     */
+    bool pop(T &item) {
+        boost::unique_lock<boost::mutex> lock(this->mutex);
+        while (this->items.empty() && !this->closed) {
+            this->notEmpty.wait(lock);
+        }
+        
+        if (this->items.empty()) {
+            return false;
+        }
+        
+        item = this->items.front();
+        this->items.pop_front();
+        this->notFull.notify_one();
+        
+        return true;
+    }
+    
+    /**
+     * No more items will be pushed, wakes up all waiting consumers.
+     */
+    void close() {
+        boost::unique_lock<boost::mutex> lock(this->mutex);
+        this->closed = true;
+        this->notEmpty.notify_all();
+    }
+    
+private:
+    
+    int capacity;
+    bool closed;
+    std::deque<T> items;
+    boost::mutex mutex;
+    boost::condition_variable notEmpty;
+    boost::condition_variable notFull;
+};
+
+/**
+ * An image passed through the pipeline; labels are filled by the workers.
+ */
+struct Job {
+    boost::filesystem::path path;
+    cv::Mat image;
+    cv::Mat_<int> labels;
+    double time;
+    std::vector<int> iterations;
+};
+
+/**
+ * Read all images and hand them to the workers.
+ * 
+ * @param std::vector<boost::filesystem::path> images
+ * @param BoundedQueue<Job> decoded
+ */
+void decode(const std::vector<boost::filesystem::path> &images, BoundedQueue<Job> &decoded) {
+    for (std::vector<boost::filesystem::path>::const_iterator iterator = images.begin(); iterator != images.end(); ++iterator) {
+        Job job;
+        job.path = *iterator;
+        job.image = cv::imread(iterator->string());
+        job.time = 0;
+        
+        // Unreadable images are passed on with empty labels and skipped when writing.
+        decoded.push(job);
+    }
+    
+    decoded.close();
+}
+
+/**
+ * Segmentation worker: each worker owns a segmenter which is reused for
+ * all images it processes.
+ * 
+ * @param boost::program_options::variables_map parameters
+ * @param BoundedQueue<Job> decoded
+ * @param BoundedQueue<Job> segmented
+ */
+void segment(const boost::program_options::variables_map &parameters, BoundedQueue<Job> &decoded, BoundedQueue<Job> &segmented) {
+    
+    int iterations = parameters["iterations"].as<int>();
+    int numberOfBins = parameters["bins"].as<int>();
+    int neighborhoodSize = parameters["neighborhood"].as<int>();
+    float minimumConfidence = parameters["confidence"].as<float>();
+    float spatialWeight = parameters["spatial-weight"].as<float>();
+    int superpixels = parameters["superpixels"].as<int>();
+    int threads = parameters["threads"].as<int>();
+    float sceneCut = parameters["scene-cut"].as<float>();
+    float minimumChange = parameters["minimum-change"].as<float>();
+    double timeBudget = parameters["time-budget"].as<double>();
+    bool warmStart = (parameters.find("warm-start") != parameters.end());
+    int tileSize = parameters["tile-size"].as<int>();
+    int tileOverlap = parameters["tile-overlap"].as<int>();
+    bool sparseHistograms = (parameters.find("sparse") != parameters.end());
+    bool uniformBinning = (parameters.find("uniform") != parameters.end());
+    std::string memory = parameters["memory"].as<std::string>();
+    
+    int spatialMemoryMode = SEEDSRevised::SPATIAL_MEMORY;
+    if (memory == "none") {
+        spatialMemoryMode = SEEDSRevised::NO_SPATIAL_MEMORY;
+    }
+    else if (memory == "heuristic") {
+        spatialMemoryMode = SEEDSRevised::HEURISTIC_SPATIAL_MEMORY;
+    }
+    
+    SEEDSRevisedMeanPixels* seeds = NULL;
+    SEEDSRevisedTiled* tiled = NULL;
+    
+    Job job;
+    while (decoded.pop(job)) {
+        
+        if (!job.image.empty() && tileSize > 0) {
+            if (tiled == NULL) {
+                tiled = new SEEDSRevisedTiled(superpixels, tileSize, tileOverlap, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, SEEDSRevised::BGR);
+                tiled->setNumberOfThreads(threads);
+            }
+            
+            int64 start = cv::getTickCount();
+            tiled->oversegment(job.image, iterations, job.labels);
+            job.time = (cv::getTickCount() - start)/cv::getTickFrequency();
+        }
+        else if (!job.image.empty()) {
+            if (seeds == NULL) {
+                seeds = new SEEDSRevisedMeanPixels(job.image, superpixels, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, SEEDSRevised::BGR);
+                seeds->setNumberOfThreads(threads);
+                seeds->setMinimumChange(minimumChange);
+                seeds->setSparseHistograms(sparseHistograms);
+                seeds->setUniformBinning(uniformBinning);
+                seeds->setSpatialMemoryMode(spatialMemoryMode);
+            }
+            else {
+                seeds->reset(job.image);
+            }
+            
+            // boost::timer measures processor time and is not suited for several threads.
+            int64 start = cv::getTickCount();
+            if (warmStart == true) {
+                seeds->initializeFromPreviousFrame(sceneCut);
+            }
+            else {
+                seeds->initialize();
+            }
+
+            if (timeBudget > 0) {
+                seeds->iterateWithBudget(iterations, timeBudget);
+            }
+            else {
+                seeds->iterate(iterations);
+            }
+            
+            job.time = (cv::getTickCount() - start)/cv::getTickFrequency();
+            job.iterations = seeds->getIterationsPerLevel();
+            
+            // The labels are overwritten by the next image.
+            job.labels = seeds->getLabels().clone();
+        }
+        
+        segmented.push(job);
+    }
+    
+    delete seeds;
+    delete tiled;
+}
+
+/**
+ * Closes the queue of segmented images once all workers are done.
+ * 
+ * @param boost::thread_group workers
+ * @param BoundedQueue<Job> segmented
+ */
+void finish(boost::thread_group &workers, BoundedQueue<Job> &segmented) {
+    workers.join_all();
+    segmented.close();
+}
+
+/**
+ * Write the requested outputs for a segmented image.
+ * 
+ * @param boost::program_options::variables_map parameters
+ * @param boost::filesystem::path outputDir
+ * @param Job job
+ * @param bool verbose
+ */
+void encode(const boost::program_options::variables_map &parameters, const boost::filesystem::path &outputDir, Job &job, bool verbose) {
+    
+    // The helpers in Tools.h expect the labels as two-dimensional array.
+    std::vector<int*> rows(job.labels.rows);
+    for (int i = 0; i < job.labels.rows; ++i) {
+        rows[i] = job.labels[i];
+    }
+    
+    int** labels = &rows[0];
+    cv::Mat &image = job.image;
+    boost::filesystem::path* iterator = &job.path;
+    
+    // Shared by the contour and mean images, allocated once per job.
+    cv::Mat drawing;
+    
+    if (verbose == true) {
+        std::cout << Integrity::countSuperpixels(labels, image.rows, image.cols) << " superpixels for " << iterator->string() << " in " << job.time << " seconds ..." << std::endl;
+        
+        // Not available for tiled segmentation.
+        if (!job.iterations.empty()) {
+            std::cout << "Iterations per level (from the pixel level):";
+            for (unsigned int level = 0; level < job.iterations.size(); ++level) {
+                std::cout << " " << job.iterations[level];
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    if (parameters.find("contour") != parameters.end()) {
+
+        boost::filesystem::path extension = iterator->filename().extension();
+        int position = iterator->filename().string().find(extension.string());
+        std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_contours.png";
+
+        int bgr[] = {0, 0, 204};
+        Draw::contourImage(labels, image, bgr, drawing);
+        cv::imwrite(store, drawing);
+
+        if (verbose == true) {
+            std::cout << "Image " << iterator->string() << " with contours saved to " << store << " ..." << std::endl;
+        }
+    }
+
+    if (parameters.find("labels") != parameters.end()) {
+
+        boost::filesystem::path extension = iterator->filename().extension();
+        int position = iterator->filename().string().find(extension.string());
+        std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_labels.png";
+
+        cv::Mat labelImage = Draw::labelImage(labels, image);
+        cv::imwrite(store, labelImage);
+
+        if (verbose == true) {
+            std::cout << "Image " << iterator->string() << " with labels saved to " << store << " ..." << std::endl;
+        }
+    }
+
+    if (parameters.find("mean") != parameters.end()) {
+
+        boost::filesystem::path extension = iterator->extension();
+        int position = iterator->filename().string().find(extension.string());
+        std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_mean.png";
+
+        Draw::meanImage(labels, image, drawing);
+        cv::imwrite(store, drawing);
+
+        if (verbose == true) {
+            std::cout << "Image " << iterator->string() << " with mean colors saved to " << store << " ..." << std::endl;
+        }
+    }
+
+    if (parameters.find("csv") != parameters.end()) {
+
+        boost::filesystem::path extension = iterator->extension();
+        int position = iterator->filename().string().find(extension.string());
+        boost::filesystem::path csvFile(outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + ".csv");
+        Export::CSV(labels, image.rows, image.cols, csvFile);
+
+        if (verbose == true) {
+            std::cout << "Labels for image " << iterator->string() << " saved in " << csvFile.string() << " ..." << std::endl;
+        }
+    }
+}
+
 int main(int argc, const char** argv) {
     
     boost::program_options::options_description desc("Allowed options");
@@ -92,6 +419,17 @@ int main(int argc, const char** argv) {
         ("iterations", boost::program_options::value<int>()->default_value(2), "iterations at each level")
         ("spatial-weight", boost::program_options::value<float>()->default_value(0.25), "spatial weight")
         ("superpixels", boost::program_options::value<int>()->default_value(400), "desired number of supüerpixels")
+        ("threads", boost::program_options::value<int>()->default_value(1), "number of threads used for block and pixel updates")
+        ("sparse", "store the histograms of small blocks sparsely, faster for large --bins")
+        ("uniform", "bin the color channels uniformly instead of using equally filled bins")
+        ("memory", boost::program_options::value<std::string>()->default_value("plain"), "spatial memory used for block and pixel updates: none, plain or heuristic")
+        ("warm-start", "treat the images as consecutive video frames and start from the segmentation of the previous frame")
+        ("scene-cut", boost::program_options::value<float>()->default_value(0.5), "minimum similarity between consecutive frames used for --warm-start, below a scene cut is assumed")
+        ("minimum-change", boost::program_options::value<float>()->default_value(0), "fraction of blocks or pixels to be moved in an iteration to continue at the current level")
+        ("time-budget", boost::program_options::value<double>()->default_value(0), "maximum time in seconds for the iterations on each image, 0 for no limit")
+        ("tile-size", boost::program_options::value<int>()->default_value(0), "segment large images in tiles of at least this size, using --threads tiles in parallel, 0 to disable; ignores --warm-start, --minimum-change and --time-budget")
+        ("tile-overlap", boost::program_options::value<int>()->default_value(32), "number of pixels by which the tiles overlap on each side, used to stitch superpixels across tiles")
+        ("jobs", boost::program_options::value<int>()->default_value(1), "number of images segmented concurrently, images are read and written in separate threads")
         ("verbose", "show additional information while processing")
         ("csv", "save segmentation as CSV file")
         ("contour", "save contour image of segmentation")
@@ -111,6 +449,19 @@ int main(int argc, const char** argv) {
         return 1;
     }
     
+    // Images are read as color images, see decode.
+    int numberOfBins = parameters["bins"].as<int>();
+    if (numberOfBins < 1 || numberOfBins > SEEDSRevised::getMaximumNumberOfBins(3)) {
+        std::cout << "Invalid number of bins " << numberOfBins << ", use between 1 and " << SEEDSRevised::getMaximumNumberOfBins(3) << " ..." << std::endl;
+        return 1;
+    }
+    
+    std::string memory = parameters["memory"].as<std::string>();
+    if (memory != "none" && memory != "plain" && memory != "heuristic") {
+        std::cout << "Unknown spatial memory " << memory << ", use none, plain or heuristic ..." << std::endl;
+        return 1;
+    }
+    
     boost::filesystem::path outputDir(parameters["output"].as<std::string>());
     if (!boost::filesystem::is_directory(outputDir)) {
         boost::filesystem::create_directory(outputDir);
@@ -158,87 +509,50 @@ int main(int argc, const char** argv) {
     
     std::cout << count << " images total ..." << std::endl;
     
-    int iterations = parameters["iterations"].as<int>();
-    int numberOfBins = parameters["bins"].as<int>();
-    int neighborhoodSize = parameters["neighborhood"].as<int>();
-    float minimumConfidence = parameters["confidence"].as<float>();
-    float spatialWeight = parameters["spatial-weight"].as<float>();
-    int superpixels = parameters["superpixels"].as<int>();
+    int jobs = parameters["jobs"].as<int>();
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    
+    // Consecutive frames need to be segmented by the same worker in order.
+    if (parameters.find("warm-start") != parameters.end() && jobs > 1) {
+        std::cout << "--warm-start processes the images in order, using --jobs 1 ..." << std::endl;
+        jobs = 1;
+    }
+    
+    // Images are read by one thread, segmented by jobs workers and written by the
+    // main thread; the queues bound the number of images in memory.
+    BoundedQueue<Job> decoded(2*jobs);
+    BoundedQueue<Job> segmented(2*jobs);
+    
+    int64 start = cv::getTickCount();
+    boost::thread decoder(decode, boost::cref(images), boost::ref(decoded));
+    
+    boost::thread_group workers;
+    for (int k = 0; k < jobs; ++k) {
+        workers.create_thread(boost::bind(segment, boost::cref(parameters), boost::ref(decoded), boost::ref(segmented)));
+    }
+    
+    boost::thread closer(finish, boost::ref(workers), boost::ref(segmented));
     
-    boost::timer timer;
     double totalTime = 0;
     
-    for(std::vector<boost::filesystem::path>::iterator iterator = images.begin(); iterator != images.end(); ++iterator) {
-        cv::Mat image = cv::imread(iterator->string());
-        
-        SEEDSRevisedMeanPixels seeds(image, superpixels, numberOfBins, neighborhoodSize, minimumConfidence, spatialWeight, SEEDSRevised::BGR);
-
-        timer.restart();
-        seeds.initialize();
-        seeds.iterate(iterations);
-        totalTime += timer.elapsed();
-        
-        if (verbose == true) {
-            std::cout << Integrity::countSuperpixels(seeds.getLabels(), image.rows, image.cols) << " superpixels for " << iterator->string() << " seconds ..." << std::endl;
-        }
-
-        if (parameters.find("contour") != parameters.end()) {
-
-            boost::filesystem::path extension = iterator->filename().extension();
-            int position = iterator->filename().string().find(extension.string());
-            std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_contours.png";
-
-            int bgr[] = {0, 0, 204};
-            cv::Mat contourImage = Draw::contourImage(seeds.getLabels(), image, bgr);
-            cv::imwrite(store, contourImage);
-
-            if (verbose == true) {
-                std::cout << "Image " << iterator->string() << " with contours saved to " << store << " ..." << std::endl;
-            }
-        }
-
-        if (parameters.find("labels") != parameters.end()) {
-
-            boost::filesystem::path extension = iterator->filename().extension();
-            int position = iterator->filename().string().find(extension.string());
-            std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_labels.png";
-            
-            cv::Mat labelImage = Draw::labelImage(seeds.getLabels(), image);
-            cv::imwrite(store, labelImage);
-
-            if (verbose == true) {
-                std::cout << "Image " << iterator->string() << " with labels saved to " << store << " ..." << std::endl;
-            }
+    Job job;
+    while (segmented.pop(job)) {
+        if (job.image.empty()) {
+            std::cout << "Could not read " << job.path.string() << " ..." << std::endl;
+            continue;
         }
         
-        if (parameters.find("mean") != parameters.end()) {
-
-            boost::filesystem::path extension = iterator->extension();
-            int position = iterator->filename().string().find(extension.string());
-            std::string store = outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + "_mean.png";
-
-            cv::Mat meanImage = Draw::meanImage(seeds.getLabels(), image);
-            cv::imwrite(store, meanImage);
-
-            if (verbose == true) {
-                std::cout << "Image " << iterator->string() << " with mean colors saved to " << store << " ..." << std::endl;
-            }
-        }
-
-        if (parameters.find("csv") != parameters.end()) {
-
-            boost::filesystem::path extension = iterator->extension();
-            int position = iterator->filename().string().find(extension.string());
-            boost::filesystem::path csvFile(outputDir.string() + DIRECTORY_SEPARATOR + iterator->filename().string().substr(0, position) + ".csv");
-            Export::CSV(seeds.getLabels(), image.rows, image.cols, csvFile);
-
-            if (verbose == true) {
-                std::cout << "Labels for image " << iterator->string() << " saved in " << csvFile.string() << " ..." << std::endl;
-            }
-        }
+        totalTime += job.time;
+        encode(parameters, outputDir, job, verbose);
     }
     
+    decoder.join();
+    closer.join();
+    
     std::cout << "On average, " << totalTime/images.size() << " seconds needed ..." << std::endl;
+    std::cout << "In total, " << (cv::getTickCount() - start)/cv::getTickFrequency() << " seconds needed using " << jobs << " jobs ..." << std::endl;
     
     return 0;
 }
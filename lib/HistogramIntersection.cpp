@@ -0,0 +1,452 @@
+/**
+ * Histogram intersection kernels used by SEEDSRevised to score block updates,
+ * see HistogramIntersection.
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HistogramIntersection.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define SEEDS_REVISED_X86
+    #include <immintrin.h>
+#endif
+
+/**
+ * GCC and Clang only allow intrinsics of instruction sets enabled for the function,
+ * MSVC allows all intrinsics anywhere.
+ */
+#if defined(__GNUC__)
+    #define SEEDS_REVISED_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define SEEDS_REVISED_TARGET(isa)
+#endif
+
+/**
+ * Sum up the partial sums of all lanes, always in the same order.
+ * 
+ * @param const float* partials LANES partial sums
+ * @return 
+ */
+static inline float reduceLanes(const float* partials) {
+    float sum = 0;
+    for (int l = 0; l < HistogramIntersection::LANES; ++l) {
+        sum += partials[l];
+    }
+    
+    return sum;
+}
+
+/**
+ * Bin k is accumulated in partial sum k % LANES, the SIMD kernels below use the
+ * same layout. The block histogram may use 16 or 32 bit bins.
+ */
+template <typename BlockType, int N>
+static void intersectScalarN(const BlockType* block, const int* const* histograms, const float* reciprocals, 
+        float blockReciprocal, int length, float* scores) {
+    
+    const int LANES = HistogramIntersection::LANES;
+    float partials[N][LANES];
+    
+    for (int n = 0; n < N; ++n) {
+        for (int l = 0; l < LANES; ++l) {
+            partials[n][l] = 0;
+        }
+    }
+    
+    for (int k = 0; k < length; k += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+            int blockBin = block[k + l];
+            float blockScore = blockBin*blockReciprocal;
+            int difference = std::max(histograms[0][k + l] - blockBin, 0);
+            
+            partials[0][l] += std::min(difference*reciprocals[0], blockScore);
+            for (int n = 1; n < N; ++n) {
+                partials[n][l] += std::min(histograms[n][k + l]*reciprocals[n], blockScore);
+            }
+        }
+    }
+    
+    for (int n = 0; n < N; ++n) {
+        scores[n] = reduceLanes(partials[n]);
+    }
+}
+
+/**
+ * Dispatches on the number of histograms such that the loops over the candidates
+ * are unrolled.
+ */
+#define SEEDS_REVISED_KERNEL(name, kernel, BlockType) \
+    static void name(const BlockType* block, const int* const* histograms, const float* reciprocals, \
+            int count, float blockReciprocal, int length, float* scores) { \
+        switch (count) { \
+            case 1: kernel<BlockType, 1>(block, histograms, reciprocals, blockReciprocal, length, scores); break; \
+            case 2: kernel<BlockType, 2>(block, histograms, reciprocals, blockReciprocal, length, scores); break; \
+            case 3: kernel<BlockType, 3>(block, histograms, reciprocals, blockReciprocal, length, scores); break; \
+            case 4: kernel<BlockType, 4>(block, histograms, reciprocals, blockReciprocal, length, scores); break; \
+            default: assert(count == 5); kernel<BlockType, 5>(block, histograms, reciprocals, blockReciprocal, length, scores); break; \
+        } \
+    }
+
+SEEDS_REVISED_KERNEL(intersectScalarWide, intersectScalarN, int)
+SEEDS_REVISED_KERNEL(intersectScalarNarrow, intersectScalarN, unsigned short)
+
+void HistogramIntersection::intersectScalar(const int* block, const int* const* histograms, const float* reciprocals, 
+        int count, float blockReciprocal, int length, float* scores) {
+    intersectScalarWide(block, histograms, reciprocals, count, blockReciprocal, length, scores);
+}
+
+void HistogramIntersection::intersectScalarNarrow(const unsigned short* block, const int* const* histograms, const float* reciprocals, 
+        int count, float blockReciprocal, int length, float* scores) {
+    ::intersectScalarNarrow(block, histograms, reciprocals, count, blockReciprocal, length, scores);
+}
+
+/**
+ * Bins not contained in the block contribute nothing, so only the given bins
+ * are visited.
+ */
+template <int N>
+static void intersectSparseN(const unsigned short* bins, const unsigned short* counts, int length, const int* const* histograms, 
+        const float* reciprocals, float blockReciprocal, float* scores) {
+    
+    float sums[N];
+    for (int n = 0; n < N; ++n) {
+        sums[n] = 0;
+    }
+    
+    for (int k = 0; k < length; ++k) {
+        int bin = bins[k];
+        float blockScore = counts[k]*blockReciprocal;
+        int difference = std::max(histograms[0][bin] - counts[k], 0);
+        
+        sums[0] += std::min(difference*reciprocals[0], blockScore);
+        for (int n = 1; n < N; ++n) {
+            sums[n] += std::min(histograms[n][bin]*reciprocals[n], blockScore);
+        }
+    }
+    
+    for (int n = 0; n < N; ++n) {
+        scores[n] = sums[n];
+    }
+}
+
+void HistogramIntersection::intersectSparse(const unsigned short* bins, const unsigned short* counts, int length, const int* const* histograms, 
+        const float* reciprocals, int count, float blockReciprocal, float* scores) {
+    
+    switch (count) {
+        case 1:
+            intersectSparseN<1>(bins, counts, length, histograms, reciprocals, blockReciprocal, scores);
+            break;
+        case 2:
+            intersectSparseN<2>(bins, counts, length, histograms, reciprocals, blockReciprocal, scores);
+            break;
+        case 3:
+            intersectSparseN<3>(bins, counts, length, histograms, reciprocals, blockReciprocal, scores);
+            break;
+        case 4:
+            intersectSparseN<4>(bins, counts, length, histograms, reciprocals, blockReciprocal, scores);
+            break;
+        default:
+            assert(count == 5);
+            intersectSparseN<5>(bins, counts, length, histograms, reciprocals, blockReciprocal, scores);
+            break;
+    }
+}
+
+#ifdef SEEDS_REVISED_X86
+
+/**
+ * Load four bins of a block histogram as 32 bit integers.
+ */
+SEEDS_REVISED_TARGET("sse2")
+static inline __m128i loadBlockSSE2(const int* block) {
+    return _mm_loadu_si128((const __m128i*) block);
+}
+
+SEEDS_REVISED_TARGET("sse2")
+static inline __m128i loadBlockSSE2(const unsigned short* block) {
+    return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*) block), _mm_setzero_si128());
+}
+
+/**
+ * SSE2 kernel, four vectors of four lanes per histogram.
+ */
+template <typename BlockType, int N>
+SEEDS_REVISED_TARGET("sse2")
+static void intersectSSE2N(const BlockType* block, const int* const* histograms, const float* reciprocals, 
+        float blockReciprocal, int length, float* scores) {
+    
+    __m128 partials[N][4];
+    __m128 superpixelReciprocals[N];
+    
+    for (int n = 0; n < N; ++n) {
+        superpixelReciprocals[n] = _mm_set1_ps(reciprocals[n]);
+        for (int q = 0; q < 4; ++q) {
+            partials[n][q] = _mm_setzero_ps();
+        }
+    }
+    
+    const __m128 blockReciprocals = _mm_set1_ps(blockReciprocal);
+    const __m128i zero = _mm_setzero_si128();
+    
+    for (int k = 0; k < length; k += HistogramIntersection::LANES) {
+        for (int q = 0; q < 4; ++q) {
+            __m128i blockBins = loadBlockSSE2(block + k + 4*q);
+            __m128 blockScore = _mm_mul_ps(_mm_cvtepi32_ps(blockBins), blockReciprocals);
+            
+            // SSE2 has no _mm_max_epi32, so max(difference, 0) is done using a mask.
+            __m128i difference = _mm_sub_epi32(_mm_loadu_si128((const __m128i*) (histograms[0] + k + 4*q)), blockBins);
+            difference = _mm_and_si128(difference, _mm_cmpgt_epi32(difference, zero));
+            
+            partials[0][q] = _mm_add_ps(partials[0][q], _mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(difference), superpixelReciprocals[0]), blockScore));
+            for (int n = 1; n < N; ++n) {
+                __m128i bins = _mm_loadu_si128((const __m128i*) (histograms[n] + k + 4*q));
+                partials[n][q] = _mm_add_ps(partials[n][q], _mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(bins), superpixelReciprocals[n]), blockScore));
+            }
+        }
+    }
+    
+    float lanes[HistogramIntersection::LANES];
+    for (int n = 0; n < N; ++n) {
+        for (int q = 0; q < 4; ++q) {
+            _mm_storeu_ps(lanes + 4*q, partials[n][q]);
+        }
+        
+        scores[n] = reduceLanes(lanes);
+    }
+}
+
+/**
+ * Load eight bins of a block histogram as 32 bit integers.
+ */
+SEEDS_REVISED_TARGET("avx2")
+static inline __m256i loadBlockAVX2(const int* block) {
+    return _mm256_loadu_si256((const __m256i*) block);
+}
+
+SEEDS_REVISED_TARGET("avx2")
+static inline __m256i loadBlockAVX2(const unsigned short* block) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) block));
+}
+
+/**
+ * AVX2 kernel, two vectors of eight lanes per histogram.
+ */
+template <typename BlockType, int N>
+SEEDS_REVISED_TARGET("avx2")
+static void intersectAVX2N(const BlockType* block, const int* const* histograms, const float* reciprocals, 
+        float blockReciprocal, int length, float* scores) {
+    
+    __m256 partials[N][2];
+    __m256 superpixelReciprocals[N];
+    
+    for (int n = 0; n < N; ++n) {
+        superpixelReciprocals[n] = _mm256_set1_ps(reciprocals[n]);
+        for (int q = 0; q < 2; ++q) {
+            partials[n][q] = _mm256_setzero_ps();
+        }
+    }
+    
+    const __m256 blockReciprocals = _mm256_set1_ps(blockReciprocal);
+    const __m256i zero = _mm256_setzero_si256();
+    
+    for (int k = 0; k < length; k += HistogramIntersection::LANES) {
+        for (int q = 0; q < 2; ++q) {
+            __m256i blockBins = loadBlockAVX2(block + k + 8*q);
+            __m256 blockScore = _mm256_mul_ps(_mm256_cvtepi32_ps(blockBins), blockReciprocals);
+            
+            __m256i difference = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*) (histograms[0] + k + 8*q)), blockBins);
+            difference = _mm256_max_epi32(difference, zero);
+            
+            partials[0][q] = _mm256_add_ps(partials[0][q], _mm256_min_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(difference), superpixelReciprocals[0]), blockScore));
+            for (int n = 1; n < N; ++n) {
+                __m256i bins = _mm256_loadu_si256((const __m256i*) (histograms[n] + k + 8*q));
+                partials[n][q] = _mm256_add_ps(partials[n][q], _mm256_min_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(bins), superpixelReciprocals[n]), blockScore));
+            }
+        }
+    }
+    
+    float lanes[HistogramIntersection::LANES];
+    for (int n = 0; n < N; ++n) {
+        for (int q = 0; q < 2; ++q) {
+            _mm256_storeu_ps(lanes + 8*q, partials[n][q]);
+        }
+        
+        scores[n] = reduceLanes(lanes);
+    }
+}
+
+/**
+ * Load sixteen bins of a block histogram as 32 bit integers.
+ */
+SEEDS_REVISED_TARGET("avx512f")
+static inline __m512i loadBlockAVX512(const int* block) {
+    return _mm512_loadu_si512((const void*) block);
+}
+
+SEEDS_REVISED_TARGET("avx512f")
+static inline __m512i loadBlockAVX512(const unsigned short* block) {
+    return _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*) block));
+}
+
+/**
+ * AVX-512 kernel, one vector of sixteen lanes per histogram.
+ */
+template <typename BlockType, int N>
+SEEDS_REVISED_TARGET("avx512f")
+static void intersectAVX512N(const BlockType* block, const int* const* histograms, const float* reciprocals, 
+        float blockReciprocal, int length, float* scores) {
+    
+    __m512 partials[N];
+    __m512 superpixelReciprocals[N];
+    
+    for (int n = 0; n < N; ++n) {
+        superpixelReciprocals[n] = _mm512_set1_ps(reciprocals[n]);
+        partials[n] = _mm512_setzero_ps();
+    }
+    
+    const __m512 blockReciprocals = _mm512_set1_ps(blockReciprocal);
+    const __m512i zero = _mm512_setzero_si512();
+    
+    for (int k = 0; k < length; k += HistogramIntersection::LANES) {
+        __m512i blockBins = loadBlockAVX512(block + k);
+        __m512 blockScore = _mm512_mul_ps(_mm512_cvtepi32_ps(blockBins), blockReciprocals);
+        
+        __m512i difference = _mm512_sub_epi32(_mm512_loadu_si512((const void*) (histograms[0] + k)), blockBins);
+        difference = _mm512_max_epi32(difference, zero);
+        
+        partials[0] = _mm512_add_ps(partials[0], _mm512_min_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(difference), superpixelReciprocals[0]), blockScore));
+        for (int n = 1; n < N; ++n) {
+            __m512i bins = _mm512_loadu_si512((const void*) (histograms[n] + k));
+            partials[n] = _mm512_add_ps(partials[n], _mm512_min_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(bins), superpixelReciprocals[n]), blockScore));
+        }
+    }
+    
+    float lanes[HistogramIntersection::LANES];
+    for (int n = 0; n < N; ++n) {
+        _mm512_storeu_ps(lanes, partials[n]);
+        scores[n] = reduceLanes(lanes);
+    }
+}
+
+SEEDS_REVISED_KERNEL(intersectSSE2, intersectSSE2N, int)
+SEEDS_REVISED_KERNEL(intersectAVX2, intersectAVX2N, int)
+SEEDS_REVISED_KERNEL(intersectAVX512, intersectAVX512N, int)
+
+SEEDS_REVISED_KERNEL(intersectSSE2Narrow, intersectSSE2N, unsigned short)
+SEEDS_REVISED_KERNEL(intersectAVX2Narrow, intersectAVX2N, unsigned short)
+SEEDS_REVISED_KERNEL(intersectAVX512Narrow, intersectAVX512N, unsigned short)
+
+const HistogramIntersection::Kernel HistogramIntersection::intersectSSE2 = ::intersectSSE2;
+const HistogramIntersection::Kernel HistogramIntersection::intersectAVX2 = ::intersectAVX2;
+const HistogramIntersection::Kernel HistogramIntersection::intersectAVX512 = ::intersectAVX512;
+
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectSSE2Narrow = ::intersectSSE2Narrow;
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectAVX2Narrow = ::intersectAVX2Narrow;
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectAVX512Narrow = ::intersectAVX512Narrow;
+
+#else
+
+const HistogramIntersection::Kernel HistogramIntersection::intersectSSE2 = NULL;
+const HistogramIntersection::Kernel HistogramIntersection::intersectAVX2 = NULL;
+const HistogramIntersection::Kernel HistogramIntersection::intersectAVX512 = NULL;
+
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectSSE2Narrow = NULL;
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectAVX2Narrow = NULL;
+const HistogramIntersection::NarrowKernel HistogramIntersection::intersectAVX512Narrow = NULL;
+
+#endif
+
+HistogramIntersection::Kernel HistogramIntersection::selectKernel() {
+    
+    #ifdef SEEDS_REVISED_X86
+        // OpenCV 2.4 does not know about AVX2 and AVX-512.
+        #ifdef CV_CPU_AVX_512F
+            if (cv::checkHardwareSupport(CV_CPU_AVX_512F)) {
+                return HistogramIntersection::intersectAVX512;
+            }
+        #endif
+
+        #ifdef CV_CPU_AVX2
+            if (cv::checkHardwareSupport(CV_CPU_AVX2)) {
+                return HistogramIntersection::intersectAVX2;
+            }
+        #endif
+
+        if (cv::checkHardwareSupport(CV_CPU_SSE2)) {
+            return HistogramIntersection::intersectSSE2;
+        }
+    #endif
+    
+    return HistogramIntersection::intersectScalar;
+}
+
+HistogramIntersection::NarrowKernel HistogramIntersection::selectNarrowKernel() {
+    
+    #ifdef SEEDS_REVISED_X86
+        #ifdef CV_CPU_AVX_512F
+            if (cv::checkHardwareSupport(CV_CPU_AVX_512F)) {
+                return HistogramIntersection::intersectAVX512Narrow;
+            }
+        #endif
+
+        #ifdef CV_CPU_AVX2
+            if (cv::checkHardwareSupport(CV_CPU_AVX2)) {
+                return HistogramIntersection::intersectAVX2Narrow;
+            }
+        #endif
+
+        if (cv::checkHardwareSupport(CV_CPU_SSE2)) {
+            return HistogramIntersection::intersectSSE2Narrow;
+        }
+    #endif
+    
+    return HistogramIntersection::intersectScalarNarrow;
+}
+
+const char* HistogramIntersection::getKernelName(Kernel kernel) {
+    if (kernel == NULL) {
+        return "none";
+    }
+    else if (kernel == HistogramIntersection::intersectAVX512) {
+        return "AVX-512";
+    }
+    else if (kernel == HistogramIntersection::intersectAVX2) {
+        return "AVX2";
+    }
+    else if (kernel == HistogramIntersection::intersectSSE2) {
+        return "SSE2";
+    }
+    
+    return "C++";
+}
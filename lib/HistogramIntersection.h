@@ -0,0 +1,172 @@
+/**
+ * Histogram intersection kernels used by SEEDSRevised to score block updates,
+ * see HistogramIntersection.
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SEEDS_REVISED_HISTOGRAM_INTERSECTION_H
+#define	SEEDS_REVISED_HISTOGRAM_INTERSECTION_H
+
+/**
+ * Class HistogramIntersection provides the kernels used to score a block against
+ * the superpixel it belongs to and against up to four candidate superpixels in
+ * a single pass over the block histogram.
+ * 
+ * The kernel is chosen at runtime according to the instruction sets supported
+ * by the CPU (AVX-512, AVX2, SSE2 or plain C++). All kernels accumulate the
+ * bins in the same order, so the scores do not depend on the chosen kernel.
+ * 
+ * Block histograms come in two widths: blocks with at most 65535 pixels use
+ * 16 bit bins, see NarrowKernel, larger blocks 32 bit bins, see Kernel. The
+ * superpixel histograms always use 32 bit bins.
+ * 
+ * @author David Stutz
+ */
+class HistogramIntersection {
+
+public:
+    
+    /**
+     * Histogram lengths need to be a multiple of this number of bins, the
+     * additional bins need to be zero.
+     */
+    static const int LANES = 16;
+    
+    /**
+     * Maximum number of candidate superpixels scored in one pass.
+     */
+    static const int MAX_CANDIDATES = 4;
+    
+    /**
+     * Computes the scores of the given block for the superpixel it belongs to
+     * and for count - 1 candidate superpixels:
+     * 
+     *  scores[0] = sum_k min(max(histograms[0][k] - block[k], 0)*reciprocals[0], block[k]*blockReciprocal)
+     *  scores[n] = sum_k min(histograms[n][k]*reciprocals[n], block[k]*blockReciprocal)
+     * 
+     * where the reciprocals are 1/(superpixel pixels - block pixels) for the
+     * superpixel the block belongs to, 1/(superpixel pixels) for the candidates
+     * and 1/(block pixels) for the block.
+     * 
+     * @param const int* block block histogram
+     * @param const int* const* histograms superpixel histogram followed by the candidate histograms
+     * @param const float* reciprocals
+     * @param int count number of histograms, between 1 and MAX_CANDIDATES + 1
+     * @param float blockReciprocal
+     * @param int length length of the histograms, a multiple of LANES
+     * @param float* scores
+     */
+    typedef void (*Kernel)(const int* block, const int* const* histograms, const float* reciprocals, 
+            int count, float blockReciprocal, int length, float* scores);
+    
+    /**
+     * Computes the same scores as Kernel for a block histogram with 16 bit bins.
+     */
+    typedef void (*NarrowKernel)(const unsigned short* block, const int* const* histograms, const float* reciprocals, 
+            int count, float blockReciprocal, int length, float* scores);
+    
+    /**
+     * Get the fastest kernel supported by the CPU.
+     * 
+     * @return
+     */
+    static Kernel selectKernel();
+    
+    /**
+     * Get the fastest kernel for 16 bit block histograms supported by the CPU.
+     * 
+     * @return
+     */
+    static NarrowKernel selectNarrowKernel();
+    
+    /**
+     * Get the name of the given kernel, for example "AVX2".
+     * 
+     * @param Kernel kernel
+     * @return
+     */
+    static const char* getKernelName(Kernel kernel);
+    
+    /**
+     * Plain C++ kernel, also used as reference for the others.
+     */
+    static void intersectScalar(const int* block, const int* const* histograms, const float* reciprocals, 
+            int count, float blockReciprocal, int length, float* scores);
+    
+    /**
+     * Plain C++ kernel for 16 bit block histograms.
+     */
+    static void intersectScalarNarrow(const unsigned short* block, const int* const* histograms, const float* reciprocals, 
+            int count, float blockReciprocal, int length, float* scores);
+    
+    /**
+     * Computes the same scores for a sparse block histogram, only visiting
+     * the non-empty bins of the block; the scores are summed in the order of
+     * the given bins.
+     * 
+     * @param const unsigned short* bins non-empty bins of the block
+     * @param const unsigned short* counts counts of these bins
+     * @param int length number of non-empty bins
+     * @param const int* const* histograms superpixel histogram followed by the candidate histograms
+     * @param const float* reciprocals
+     * @param int count number of histograms, between 1 and MAX_CANDIDATES + 1
+     * @param float blockReciprocal
+     * @param float* scores
+     */
+    static void intersectSparse(const unsigned short* bins, const unsigned short* counts, int length, const int* const* histograms, 
+            const float* reciprocals, int count, float blockReciprocal, float* scores);
+    
+    /**
+     * SSE2 kernel, NULL if not available on the target architecture.
+     */
+    static const Kernel intersectSSE2;
+    
+    /**
+     * AVX2 kernel, NULL if not available on the target architecture.
+     */
+    static const Kernel intersectAVX2;
+    
+    /**
+     * AVX-512 kernel, NULL if not available on the target architecture.
+     */
+    static const Kernel intersectAVX512;
+    
+    /**
+     * SSE2, AVX2 and AVX-512 kernels for 16 bit block histograms, NULL if not
+     * available on the target architecture.
+     */
+    static const NarrowKernel intersectSSE2Narrow;
+    static const NarrowKernel intersectAVX2Narrow;
+    static const NarrowKernel intersectAVX512Narrow;
+};
+
+#endif	/* SEEDS_REVISED_HISTOGRAM_INTERSECTION_H */
+
@@ -64,6 +64,7 @@
 #include "SeedsRevised.h"
 #include <opencv2/opencv.hpp>
 #include <math.h>
+#include <algorithm>
 #include <string>
 
 SEEDSRevised::SEEDSRevised(const cv::Mat &image, int numberOfLevels, int minimumBlockWidth, int minimumBlockHeight, int numberOfBins, int neighborhoodSize, float minimumConfidence, int colorSpace) {
@@ -72,8 +73,17 @@ SEEDSRevised::SEEDSRevised(const cv::Mat &image, int numberOfLevels, int minimum
 
 SEEDSRevised::SEEDSRevised(const cv::Mat &image, int desiredNumberOfSuperpixels, int numberOfBins, int neighborhoodSize, float minimumConfidence, int colorSpace) {
     
-    int width = image.cols;
-    int height = image.rows;
+    int numberOfLevels = 0;
+    int minimumBlockWidth = 0;
+    int minimumBlockHeight = 0;
+    
+    SEEDSRevised::computeBlockSize(image.cols, image.rows, desiredNumberOfSuperpixels, numberOfLevels, minimumBlockWidth, minimumBlockHeight);
+    
+    this->construct(image, numberOfBins, numberOfLevels, minimumBlockWidth, minimumBlockHeight, neighborhoodSize, minimumConfidence, colorSpace);
+    this->desiredNumberOfSuperpixels = desiredNumberOfSuperpixels;
+}
+
+void SEEDSRevised::computeBlockSize(int width, int height, int desiredNumberOfSuperpixels, int &numberOfLevels, int &minimumBlockWidth, int &minimumBlockHeight) {
     
     int minimumBlockWidths[3] = {2, 3, 4};
     int minimumBlockHeights[3] = {2, 3, 4};
@@ -108,10 +118,14 @@ SEEDSRevised::SEEDSRevised(const cv::Mat &image, int desiredNumberOfSuperpixels,
     assert(minBlockWidth > 0);
     assert(minBlockHeight > 0);
     
-    this->construct(image, numberOfBins, minLevels, minBlockWidth, minBlockHeight, neighborhoodSize, minimumConfidence, colorSpace);
+    numberOfLevels = minLevels;
+    minimumBlockWidth = minBlockWidth;
+    minimumBlockHeight = minBlockHeight;
 }
 
 void SEEDSRevised::construct(const cv::Mat &image, int numberOfBins, int numberOfLevels, int minimumBlockWidth, int minimumBlockHeight, int neighborhoodSize, float minimumConfidence, int colorSpace) {
+    CV_Assert(numberOfBins > 0 && numberOfBins <= SEEDSRevised::getMaximumNumberOfBins(image.channels()));
+    
     this->numberOfLevels = numberOfLevels;
     this->minimumBlockWidth = minimumBlockWidth;
     this->minimumBlockHeight = minimumBlockHeight;
@@ -119,10 +133,14 @@ void SEEDSRevised::construct(const cv::Mat &image, int numberOfBins, int numberO
     this->minimumConfidence = minimumConfidence;
     this->neighborhoodSize = neighborhoodSize;
     this->colorSpace = colorSpace;
+    this->uniformBinning = false;
+    this->spatialMemoryMode = SPATIAL_MEMORY;
     
     this->initializedImage = false;
     this->initializedLabels = false;
     this->initializedHistograms = false;
+    this->validPixelCache = false;
+    std::fill(&this->binLookup[0][0], &this->binLookup[0][0] + 3*256, 0);
     this->currentLevel = 0;
     this->currentBlockWidth = 0;
     this->currentBlockHeight = 0;
@@ -135,81 +153,184 @@ void SEEDSRevised::construct(const cv::Mat &image, int numberOfBins, int numberO
     this->minimumNumberOfSublabels = 1;
     this->histogramDimensions = 0;
     this->histogramSize = 0;
+    this->histogramStride = 0;
+    this->numberOfThreads = 1;
+    this->minimumChange = 0;
+    this->deadline = 0;
+    this->deadlineExceeded = false;
+    this->histograms = NULL;
+    this->narrowHistograms = NULL;
+    this->pixels = NULL;
+    this->levelWidthNumbers = NULL;
+    this->histogramArena = NULL;
+    this->currentLabels = NULL;
+    this->labelRows = NULL;
+    this->histogramBins = NULL;
+    this->sparseHistograms = false;
+    this->numberOfSparseLevels = 0;
+    this->numberOfNarrowLevels = 0;
+    this->sparseLevels = NULL;
+    this->sparseArena = NULL;
+    this->intersectionKernel = HistogramIntersection::selectKernel();
+    this->narrowIntersectionKernel = HistogramIntersection::selectNarrowKernel();
+    this->desiredNumberOfSuperpixels = 0;
     
     this->image = new cv::Mat();
+    this->initializedImage = true;
+    this->externalImage = false;
+    
+    this->copyImage(image);
+}
+
+void SEEDSRevised::copyImage(const cv::Mat &image) {
     int channels = image.channels();
     
     assert(channels == 1 || channels == 3);
     
+    // An external image must not be overwritten, see reset.
+    if (this->externalImage == true) {
+        this->image->release();
+        this->externalImage = false;
+    }
+    
+    // The previous image is overwritten, its memory is reused by OpenCV if
+    // size and type did not change.
     if (channels == 1) {
         image.convertTo(*this->image, CV_8UC1);
     }
-    else if (channels == 3) {
+    else if (image.depth() == CV_8U) {
+        // Converted directly from the given image, such that the image is
+        // only passed once.
+        cv::cvtColor(image, *this->image, this->getColorConversion(), 3);
+    }
+    else {
         image.convertTo(*this->image, CV_8UC3);
-        cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2Lab, 3);
+        cv::cvtColor(*this->image, *this->image, this->getColorConversion(), 3);
     }
     
+    this->updateImageSize();
+}
+
+void SEEDSRevised::updateImageSize() {
     this->height = this->image->rows;
     this->width = this->image->cols;
+    
+    // One column and row of padding on each side, rows are aligned.
+    int alignment = SEEDSRevised::ALIGNMENT/sizeof(int);
+    this->stride = ((this->width + 2 + alignment - 1)/alignment)*alignment;
 }
 
-SEEDSRevised::~SEEDSRevised() {
+bool SEEDSRevised::releaseForImage(int rows, int cols, int channels) {
     
-    if (this->initializedImage == true) {
-        delete this->image;
+    // Labels and spatial memory only depend on the size of the image, the
+    // histograms additionally depend on the number of channels.
+    bool resized = (rows != this->height || cols != this->width);
+    
+    if (resized) {
+        this->releaseLabels();
+        this->releaseHistograms();
+    }
+    else if (channels != this->image->channels()) {
+        this->releaseHistograms();
+    }
+    
+    return resized;
+}
+
+void SEEDSRevised::reset(const cv::Mat &image) {
+    bool resized = this->releaseForImage(image.rows, image.cols, image.channels());
+    
+    this->copyImage(image);
+    
+    if (resized && this->desiredNumberOfSuperpixels > 0) {
+        SEEDSRevised::computeBlockSize(this->width, this->height, this->desiredNumberOfSuperpixels, 
+                this->numberOfLevels, this->minimumBlockWidth, this->minimumBlockHeight);
+    }
+}
+
+void SEEDSRevised::reset(const unsigned char* data, int rows, int cols, size_t step, int channels) {
+    assert(data != NULL);
+    assert(channels == 1 || channels == 3);
+    assert(step >= (size_t) cols*channels);
+    
+    bool resized = this->releaseForImage(rows, cols, channels);
+    
+    // The header references the buffer of the caller without copying; the buffer
+    // is only read as the color space conversion is skipped, see copyImage.
+    *this->image = cv::Mat(rows, cols, CV_8UC(channels), (void*) data, step);
+    this->externalImage = true;
+    
+    this->updateImageSize();
+    
+    if (resized && this->desiredNumberOfSuperpixels > 0) {
+        SEEDSRevised::computeBlockSize(this->width, this->height, this->desiredNumberOfSuperpixels, 
+                this->numberOfLevels, this->minimumBlockWidth, this->minimumBlockHeight);
     }
+}
+
+void SEEDSRevised::releaseLabels() {
     
     if (this->initializedLabels == true) {
         
-        for (int i = 0; i < this->height; ++i) {
-            delete[] this->currentLabels[i];
-            delete[] this->spatialMemory[i];
-        }
+        // The planes point to the first pixel inside the padded border.
+        SEEDSRevised::freeAligned(this->currentLabels - this->stride - 1);
+        this->spatialMemory.release();
+        this->boundary.release();
         
-        delete[] this->currentLabels;
-        delete[] this->spatialMemory;
+        delete[] this->labelRows;
+        
+        this->currentLabels = NULL;
+        this->labelRows = NULL;
         this->initializedLabels = false;
     }
+}
+
+void SEEDSRevised::releaseHistograms() {
     
     if (this->initializedHistograms == true) {
         
-        int blockHeightNumber;
-        int blockWidthNumber;
-        
-        for (int level = 1; level <= this->numberOfLevels; ++level) {
-            blockHeightNumber = this->getBlockHeightNumber(level);
-            blockWidthNumber = this->getBlockWidthNumber(level);
-
-            // Note that the array is built up as a matrix: the first index references
-            // the row rather than the column.
-            for (int i = 0; i < blockHeightNumber; ++i) {
-                for (int j = 0; j < blockWidthNumber; ++j) {
-                    delete[] this->histograms[level - 1][i][j];
-                }
-                
-                delete[] this->histograms[level - 1][i];
-                delete[] this->pixels[level - 1][i];
-            }
-            
-            delete[] this->histograms[level - 1];
-            delete[] this->pixels[level - 1];
-        }
+        // All histograms and pixel counts are freed at once.
+        SEEDSRevised::freeAligned(this->histogramArena);
         
         delete[] this->histograms;
+        delete[] this->narrowHistograms;
         delete[] this->pixels;
+        delete[] this->levelWidthNumbers;
         
-        for (int i = 0; i < this->height; ++i) {
-            delete[] this->histogramBins[i];
-        }
+        SEEDSRevised::freeAligned(this->histogramBins - this->stride - 1);
+        
+        SEEDSRevised::freeAligned(this->sparseArena);
+        delete[] this->sparseLevels;
         
-        delete[] this->histogramBins;
+        this->histogramArena = NULL;
+        this->histograms = NULL;
+        this->narrowHistograms = NULL;
+        this->pixels = NULL;
+        this->levelWidthNumbers = NULL;
+        this->histogramBins = NULL;
+        this->sparseArena = NULL;
+        this->sparseLevels = NULL;
         this->initializedHistograms = false;
     }
 }
 
+SEEDSRevised::~SEEDSRevised() {
+    
+    if (this->initializedImage == true) {
+        delete this->image;
+    }
+    
+    this->releaseLabels();
+    SEEDSRevised::releaseHistograms();
+}
+
 void SEEDSRevised::setNumberOfLevels(int numberOfLevels) {
     assert(numberOfLevels >= 2);
     
+    if (numberOfLevels != this->numberOfLevels) {
+        this->releaseHistograms();
+    }
+    
     this->numberOfLevels = numberOfLevels;
 }
 
@@ -217,6 +338,10 @@ void SEEDSRevised::setMinimumBlockSize(int minimumBlockWidth, int minimumBlockHe
     assert(minimumBlockWidth > 0 && minimumBlockHeight > 0);
     assert(minimumBlockWidth*2 <= this->width && minimumBlockHeight*2 <= this->height);
     
+    if (minimumBlockWidth != this->minimumBlockWidth || minimumBlockHeight != this->minimumBlockHeight) {
+        this->releaseHistograms();
+    }
+    
     this->minimumBlockWidth = minimumBlockWidth;
     this->minimumBlockHeight = minimumBlockHeight;
 }
@@ -234,34 +359,147 @@ void SEEDSRevised::setNeighborhoodSize(int neighborhoodSize) {
 }
 
 void SEEDSRevised::setNumberOfBins(int numberOfBins) {
+    CV_Assert(numberOfBins > 0 && numberOfBins <= SEEDSRevised::getMaximumNumberOfBins(this->image->channels()));
+    
+    if (numberOfBins != this->numberOfBins) {
+        this->releaseHistograms();
+    }
+    
     this->numberOfBins = numberOfBins;
 }
 
+void SEEDSRevised::setSparseHistograms(bool sparseHistograms) {
+    
+    if (sparseHistograms != this->sparseHistograms) {
+        this->releaseHistograms();
+    }
+    
+    this->sparseHistograms = sparseHistograms;
+}
+
+void SEEDSRevised::setUniformBinning(bool uniformBinning) {
+    
+    // The bin lookup of the previous frame is not reused, see initializeFromPreviousFrame.
+    if (uniformBinning != this->uniformBinning) {
+        this->releaseHistograms();
+    }
+    
+    this->uniformBinning = uniformBinning;
+}
+
+void SEEDSRevised::setSpatialMemoryMode(int spatialMemoryMode) {
+    assert(spatialMemoryMode == NO_SPATIAL_MEMORY || spatialMemoryMode == SPATIAL_MEMORY 
+            || spatialMemoryMode == HEURISTIC_SPATIAL_MEMORY);
+    
+    this->spatialMemoryMode = spatialMemoryMode;
+}
+
+void SEEDSRevised::setNumberOfThreads(int numberOfThreads) {
+    assert(numberOfThreads > 0);
+    
+    this->numberOfThreads = numberOfThreads;
+}
+
+void SEEDSRevised::setMinimumChange(float minimumChange) {
+    assert(minimumChange >= 0);
+    assert(minimumChange <= 1);
+    
+    this->minimumChange = minimumChange;
+}
+
+const std::vector<int>& SEEDSRevised::getIterationsPerLevel() const {
+    return this->iterationsPerLevel;
+}
+
+const std::vector<int>& SEEDSRevised::getMovesPerLevel() const {
+    return this->movesPerLevel;
+}
+
 void SEEDSRevised::initialize() {
+    this->initializeLabels();
+    this->initializeHistograms();
+}
+
+bool SEEDSRevised::initializeFromPreviousFrame(float minimumSimilarity) {
+    assert(minimumSimilarity >= 0);
+    assert(minimumSimilarity <= 1);
+    
+    // The previous frame needs to be segmented down to pixel level and reset
+    // must not have released labels or histograms, i.e. the size did not change.
+    if (this->initializedLabels == false || this->initializedHistograms == false
+            || this->currentLevel > 0) {
+        this->initialize();
+        return false;
+    }
+    
+    int superpixels = this->superpixelHeightNumber*this->superpixelWidthNumber;
+    int* superpixelHistograms = this->histograms[this->numberOfLevels - 1];
+    this->previousHistograms.assign(superpixelHistograms, superpixelHistograms + superpixels*this->histogramStride);
+    
+    // The new frame is binned using the bin boundaries of the previous frame,
+    // such that both histograms are comparable. Pixel updates only need the
+    // superpixel histograms, so the block histograms are not built.
+    this->computeHistogramBins();
+    this->computeSuperpixelHistograms();
+    
+    // As the labels did not change, the overlap is the number of pixels of the
+    // new frame explained by the histograms of the previous frame.
+    int overlap = 0;
+    for (int i = 0; i < superpixels*this->histogramStride; ++i) {
+        overlap += std::min(this->previousHistograms[i], superpixelHistograms[i]);
+    }
+    
+    if (overlap < minimumSimilarity*this->height*this->width) {
+        
+        // The bin boundaries are adapted to the new scene; the bins of the
+        // pixels only need to be computed again if the boundaries changed.
+        if (this->computeBinLookup()) {
+            this->computeHistogramBins();
+        }
+        
+        this->initializeLabels();
+        this->buildHistograms();
+        return false;
+    }
+    
+    return true;
+}
+
+void SEEDSRevised::computeSuperpixelHistograms() {
+    this->validPixelCache = false;
+    
+    int superpixels = this->superpixelHeightNumber*this->superpixelWidthNumber;
+    int* superpixelHistograms = this->histograms[this->numberOfLevels - 1];
+    int* superpixelPixels = this->pixels[this->numberOfLevels - 1];
+    
+    std::fill(superpixelHistograms, superpixelHistograms + superpixels*this->histogramStride, 0);
+    std::fill(superpixelPixels, superpixelPixels + superpixels, 0);
+    
+    for (int i = 0; i < this->height; ++i) {
+        for (int j = 0; j < this->width; ++j) {
+            int label = this->currentLabels[i*this->stride + j];
+            
+            ++superpixelHistograms[label*this->histogramStride + this->histogramBins[i*this->stride + j]];
+            ++superpixelPixels[label];
+        }
+    }
+}
+
+int SEEDSRevised::getColorConversion() const {
     switch (this->colorSpace) {
         default:
         case BGR:
-            // Nothing to do.
-            break;
         case LAB:
-            cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2Lab);
-            break;
+            return SEEDS_REVISED_OPENCV_BGR2Lab;
         case HSV:
-            cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2HSV);
-            break;
+            return SEEDS_REVISED_OPENCV_BGR2HSV;
         case LUV:
-            cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2Luv);
-            break;
+            return SEEDS_REVISED_OPENCV_BGR2Luv;
         case XYZ:
-            cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2XYZ);
-            break;
+            return SEEDS_REVISED_OPENCV_BGR2XYZ;
         case YCRCB:
-            cv::cvtColor(*this->image, *this->image, SEEDS_REVISED_OPENCV_BGR2YCrCb);
-            break;
+            return SEEDS_REVISED_OPENCV_BGR2YCrCb;
     }
-    
-    this->initializeLabels();
-    this->initializeHistograms();
 }
 
 void SEEDSRevised::initializeLabels() {
@@ -288,36 +526,37 @@ void SEEDSRevised::initializeLabels() {
     // In the end each pixel will have a label, in the meantime we will simply only 
     // use a part of the matrix for the block labels such that we do not need
     // to resize the matrix at each level.
-    this->currentLabels = new int*[this->height];
+    // The plane is padded with a border of -1 labels such that pixel updates
+    // can look at all neighbors without clamping the indices.
+    // When initializing again, e.g. after reset, the planes are reused.
+    if (this->initializedLabels == false) {
+        this->currentLabels = this->allocatePlane<int>(-1);
+        this->spatialMemory.allocate(this->height, this->width);
+        this->boundary.allocate(this->height, this->width);
+        
+        // Rows of the plane for getLabelArray.
+        this->labelRows = new int*[this->height];
+        for (int i = 0; i < this->height; ++i) {
+            this->labelRows[i] = this->currentLabels + i*this->stride;
+        }
+    }
+    else {
+        this->fillPlane<int>(this->currentLabels, -1);
+        this->spatialMemory.clear();
+    }
     
     // Initialize labels in blocks of 4 blocks, as 4 blocks built one superpixel
     // at the level above.
-    for (int i = 0; i < this->height; ++i) {
-        this->currentLabels[i] = new int[this->width];
-        
-        for (int j = 0; j < this->width; ++j) {
-            
-            if (i < this->superpixelHeightNumber && j < this->superpixelWidthNumber) {
-                this->currentLabels[i][j] = label;
-                ++label;
-            }
-            // To initialize the array properly.
-            else {
-                this->currentLabels[i][j] = -1;
-            }
+    for (int i = 0; i < this->superpixelHeightNumber; ++i) {
+        for (int j = 0; j < this->superpixelWidthNumber; ++j) {
+            this->currentLabels[i*this->stride + j] = label;
+            ++label;
         }
     }
     
     // Spatial memory will remember which blocks or pixels have been updated in the
     // previous iteration, and for which blocks or pixels there will not be a change.
-    this->spatialMemory = new bool*[this->height];
-    for (int i = 0; i < this->height; ++i) {
-        this->spatialMemory[i] = new bool[this->width];
-        
-        for (int j = 0; j < this->width; ++j) {
-            this->spatialMemory[i][j] = true;
-        }
-    }
+    this->spatialMemory.setAll(this->height, this->width);
     
     this->goDownOneLevel();
     this->initializedLabels = true;
@@ -355,11 +594,27 @@ int SEEDSRevised::getBlockHeightNumber(int level) const {
     return this->height/this->getBlockHeight(level);
 }
 
+int SEEDSRevised::getBlockArea(int level, int i, int j) const {
+    int blockHeight = this->getBlockHeight(level);
+    int blockWidth = this->getBlockWidth(level);
+    
+    if (i == this->getBlockHeightNumber(level) - 1) {
+        blockHeight = this->height - i*blockHeight;
+    }
+    
+    if (j == this->getBlockWidthNumber(level) - 1) {
+        blockWidth = this->width - j*blockWidth;
+    }
+    
+    return blockHeight*blockWidth;
+}
+
 void SEEDSRevised::goDownOneLevel() {
     #ifdef DEBUG
         assert(this->currentLevel > 0);
     #endif
     
+    this->validPixelCache = false;
     --this->currentLevel;
     
     if (this->currentLevel > 0) {
@@ -370,32 +625,32 @@ void SEEDSRevised::goDownOneLevel() {
         for (int i = this->currentBlockHeightNumber - 1; i > -1; --i) {
             for (int j = this->currentBlockWidthNumber - 1; j > -1; --j) {
 
-                this->currentLabels[2*i][2*j] = this->currentLabels[i][j];
-                this->currentLabels[2*i + 1][2*j] = this->currentLabels[i][j];
-                this->currentLabels[2*i][2*j + 1] = this->currentLabels[i][j];
-                this->currentLabels[2*i + 1][2*j + 1] = this->currentLabels[i][j];
+                this->currentLabels[2*i*this->stride + 2*j] = this->currentLabels[i*this->stride + j];
+                this->currentLabels[(2*i + 1)*this->stride + 2*j] = this->currentLabels[i*this->stride + j];
+                this->currentLabels[2*i*this->stride + 2*j + 1] = this->currentLabels[i*this->stride + j];
+                this->currentLabels[(2*i + 1)*this->stride + 2*j + 1] = this->currentLabels[i*this->stride + j];
 
                 // Remember to add new diagonal pixels for the block in bottom right corner.
                 if (i == this->currentBlockHeightNumber - 1 && j == this->currentBlockWidthNumber - 1) {
                     for (int k = 2*i + 2; k < newBlockHeightNumber; ++k) {
                         for (int l = 2*j + 2; l < newBlockWidthNumber; ++l) {
-                            this->currentLabels[k][l] = this->currentLabels[i][j];
-                            this->currentLabels[k][l] = this->currentLabels[i][j];
+                            this->currentLabels[k*this->stride + l] = this->currentLabels[i*this->stride + j];
+                            this->currentLabels[k*this->stride + l] = this->currentLabels[i*this->stride + j];
                         }
                     }
                 }
 
                 if (i == this->currentBlockHeightNumber - 1) {
                     for (int k = 2*i + 2; k < newBlockHeightNumber; ++k) {
-                        this->currentLabels[k][2*j] = this->currentLabels[i][j];
-                        this->currentLabels[k][2*j + 1] = this->currentLabels[i][j];
+                        this->currentLabels[k*this->stride + 2*j] = this->currentLabels[i*this->stride + j];
+                        this->currentLabels[k*this->stride + 2*j + 1] = this->currentLabels[i*this->stride + j];
                     }
                 }
 
                 if (j == this->currentBlockWidthNumber - 1) {
                     for (int l = 2*j + 2; l < newBlockWidthNumber; ++l) {
-                        this->currentLabels[2*i][l] = this->currentLabels[i][j];
-                        this->currentLabels[2*i + 1][l] = this->currentLabels[i][j];
+                        this->currentLabels[2*i*this->stride + l] = this->currentLabels[i*this->stride + j];
+                        this->currentLabels[(2*i + 1)*this->stride + l] = this->currentLabels[i*this->stride + j];
                     }
                 }
             }
@@ -409,13 +664,11 @@ void SEEDSRevised::goDownOneLevel() {
     }
     else if (this->currentLevel == 0) {
 
-        int** blockLabels = new int*[this->currentBlockHeightNumber];
+        int* blockLabels = new int[this->currentBlockHeightNumber*this->currentBlockWidthNumber];
         
         for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
-            blockLabels[i] = new int[this->currentBlockWidthNumber];
-            
             for (int j = 0; j < this->currentBlockWidthNumber; ++j) {
-                blockLabels[i][j] = this->currentLabels[i][j];
+                blockLabels[i*this->currentBlockWidthNumber + j] = this->currentLabels[i*this->stride + j];
             }
         }
         
@@ -436,7 +689,7 @@ void SEEDSRevised::goDownOneLevel() {
                 
                 for (int k = this->minimumBlockHeight*i; k < heightEnd; ++k) {
                     for (int l = this->minimumBlockWidth*j; l < widthEnd; ++l) {
-                        this->currentLabels[k][l] = blockLabels[i][j];
+                        this->currentLabels[k*this->stride + l] = blockLabels[i*this->currentBlockWidthNumber + j];
                     }
                 }
             }
@@ -456,7 +709,7 @@ void SEEDSRevised::goDownOneLevel() {
     #ifdef DEBUG
         for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
             for (int j = 0; j < this->currentBlockWidthNumber; ++j) {
-                assert(this->currentLabels[i][j] >= 0);
+                assert(this->currentLabels[i*this->stride + j] >= 0);
             }
         }
     
@@ -477,16 +730,13 @@ void SEEDSRevised::goDownOneLevel() {
 
                 for (int i = 0; i < blockHeightNumber; ++i) {
                     for (int j = 0; j < blockWidthNumber; ++j) {
-                        sum = 0;
-                        for (int k = 0; k < this->histogramSize; ++k) {
-                            sum += this->histograms[level - 1][i][j][k];
-                        }
+                        sum = this->sumHistogram(level, i, j);
 
 //                        if (level < this->numberOfLevels) {
-//                            assert(this->pixels[level - 1][i][j] >= blockWidth*blockHeight);
+//                            assert(this->getPixels(level, i, j) >= blockWidth*blockHeight);
 //                        }
                         
-                        assert(this->pixels[level - 1][i][j] == sum);
+                        assert(this->getPixels(level, i, j) == sum);
                     }
                 }
             }
@@ -494,54 +744,79 @@ void SEEDSRevised::goDownOneLevel() {
     #endif
 }
 
-void SEEDSRevised::initializeHistograms() {
+class SEEDSRevised::HistogramBinInvoker : public cv::ParallelLoopBody {
     
-    this->histogramDimensions = this->image->channels();
-    this->histogramSize = (int) pow(this->numberOfBins, this->histogramDimensions);
-
-    #ifdef UNIFORM
-        int denominator = ceil(256./((double) this->numberOfBins));
-         
-        this->histogramBins = new int*[this->height];
-        for (int i = 0; i < this->height; ++i) {
-            this->histogramBins[i] = new int[this->width];
-
-            for (int j = 0; j < this->width; ++j) {
-                this->histogramBins[i][j] = this->histogramSize;
-                
-                if (this->histogramDimensions == 1) {
-                    this->histogramBins[i][j] = this->image->at<unsigned char>(i, j)/denominator;
+public:
+    
+    HistogramBinInvoker(SEEDSRevised* seeds, const int (*lookup)[256]) 
+            : seeds(seeds), lookup(lookup) {
+        
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        const int* lookup0 = this->lookup[0];
+        const int* lookup1 = this->lookup[1];
+        const int* lookup2 = this->lookup[2];
+        
+        for (int i = range.start; i < range.end; ++i) {
+            const unsigned char* row = this->seeds->image->ptr<unsigned char>(i);
+            unsigned short* bins = this->seeds->histogramBins + i*this->seeds->stride;
+            
+            if (this->seeds->histogramDimensions == 1) {
+                for (int j = 0; j < this->seeds->width; ++j) {
+                    bins[j] = lookup0[row[j]];
                 }
-                else if (this->histogramDimensions == 3) {
-                    this->histogramBins[i][j] = this->image->at<cv::Vec3b>(i, j)[0]/denominator + this->numberOfBins*(this->image->at<cv::Vec3b>(i, j)[1]/denominator) + this->numberOfBins*this->numberOfBins*(this->image->at<cv::Vec3b>(i, j)[2]/denominator);
+            }
+            else {
+                for (int j = 0; j < this->seeds->width; ++j) {
+                    bins[j] = lookup0[row[3*j]] + lookup1[row[3*j + 1]] + lookup2[row[3*j + 2]];
                 }
+            }
+        }
+    }
+    
+private:
+    
+    SEEDSRevised* seeds;
+    const int (*lookup)[256];
+};
 
-                #ifdef DEBUG
-                    assert(this->histogramBins[i][j] < this->histogramSize);
-                #endif
+bool SEEDSRevised::computeBinLookup() {
+    
+    // The bin of each channel value is looked up and already multiplied
+    // by the number of bins of the preceding channels, such that the bin of
+    // a pixel is the sum of one lookup per channel.
+    int lookup[3][256];
+    
+    if (this->uniformBinning == true) {
+        int denominator = ceil(256./((double) this->numberOfBins));
+        
+        for (int l = 0; l < 256; ++l) {
+            lookup[0][l] = l/denominator;
+        }
+        
+        for (int k = 1; k < this->histogramDimensions; ++k) {
+            for (int l = 0; l < 256; ++l) {
+                lookup[k][l] = this->numberOfBins*lookup[k - 1][l];
             }
         }
-    #else
-        int** channels = new int*[this->histogramDimensions];
+    }
+    else {
+        int channels[3][256];
         int count = 0;
 
         for (int k = 0; k < this->histogramDimensions; ++k) {
-            channels[k] = new int[256];
-
             for (int l = 0; l < 256; ++l) {
                 channels[k][l] = 0;
             }
         }
 
         for (int i = 0; i < this->height; i += 5) {
+            const unsigned char* row = this->image->ptr<unsigned char>(i);
+            
             for (int j = 0; j < this->width; j += 5) {
-                if (this->histogramDimensions == 1) {
-                    ++channels[0][this->image->at<unsigned char>(i, j)];
-                }
-                else if (this->histogramDimensions == 3) {
-                    ++channels[0][this->image->at<cv::Vec3b>(i, j)[0]];
-                    ++channels[1][this->image->at<cv::Vec3b>(i, j)[1]];
-                    ++channels[2][this->image->at<cv::Vec3b>(i, j)[2]];
+                for (int k = 0; k < this->histogramDimensions; ++k) {
+                    ++channels[k][row[this->histogramDimensions*j + k]];
                 }
 
                 ++count;
@@ -557,167 +832,582 @@ void SEEDSRevised::initializeHistograms() {
 
         int equiHeight = ceil(((double) (count + 1))/((double) this->numberOfBins));
         
-        this->histogramBins = new int*[this->height];
-        for (int i = 0; i < this->height; ++i) {
-            this->histogramBins[i] = new int[this->width];
-
-            for (int j = 0; j < this->width; ++j) {
-                this->histogramBins[i][j] = this->histogramSize;
-                
-                if (this->histogramDimensions == 1) {
-                    this->histogramBins[i][j] = channels[0][this->image->at<unsigned char>(i, j)]/equiHeight;
-                }
-                else if (this->histogramDimensions == 3) {
-                    this->histogramBins[i][j] = channels[0][this->image->at<cv::Vec3b>(i, j)[0]]/equiHeight
-                            + this->numberOfBins*(channels[1][this->image->at<cv::Vec3b>(i, j)[1]]/equiHeight)
-                            + this->numberOfBins*this->numberOfBins*(channels[2][this->image->at<cv::Vec3b>(i, j)[2]]/equiHeight);
-                }
-
-                #ifdef DEBUG
-                    assert(this->histogramBins[i][j] < this->histogramSize);
-                #endif
+        int factor = 1;
+        for (int k = 0; k < this->histogramDimensions; ++k) {
+            for (int l = 0; l < 256; ++l) {
+                lookup[k][l] = factor*(channels[k][l]/equiHeight);
             }
+            
+            factor *= this->numberOfBins;
+        }
+    }
+    
+    bool changed = false;
+    for (int k = 0; k < this->histogramDimensions; ++k) {
+        if (!std::equal(lookup[k], lookup[k] + 256, this->binLookup[k])) {
+            std::copy(lookup[k], lookup[k] + 256, this->binLookup[k]);
+            changed = true;
         }
+    }
+    
+    return changed;
+}
+
+void SEEDSRevised::computeHistogramBins() {
+    
+    #ifdef DEBUG
+        assert(this->histogramDimensions == 1 || this->histogramDimensions == 3);
         
         for (int k = 0; k < this->histogramDimensions; ++k) {
-            delete[] channels[k];
+            assert(this->binLookup[k][255] < (int) pow(this->numberOfBins, k + 1));
         }
-        
-        delete[] channels;
     #endif
-
-    int minimumBlockHeightNumber = this->getBlockHeightNumber(1);
-    int minimumBlockWidthNumber = this->getBlockWidthNumber(1);
-
-    int blockHeightEnd;
-    int blockWidthEnd;
-
-    this->histograms = new int***[this->numberOfLevels];
-    this->pixels = new int**[this->numberOfLevels];
-
-    this->histograms[0] = new int**[minimumBlockHeightNumber];
-    this->pixels[0] = new int*[minimumBlockHeightNumber];
-        
-    for (int i = 0; i < minimumBlockHeightNumber; ++i) {
-        this->histograms[0][i] = new int*[minimumBlockWidthNumber];
-        this->pixels[0][i] = new int[minimumBlockWidthNumber];
-
-        for (int j = 0; j < minimumBlockWidthNumber; ++j) {
-            this->histograms[0][i][j] = new int[this->histogramSize];
-            this->pixels[0][i][j] = 0;
-
-            // Initialize histogram bins.
-            for (int k = 0; k < this->histogramSize; ++k) {
-                this->histograms[0][i][j][k] = 0;
-            }
-
-            // Remember the borders, blockHeightEnd and blockWidthEnd
-            // are exclusive indices.
-            blockHeightEnd = (i + 1)*this->minimumBlockHeight;
-            blockWidthEnd = (j + 1)*this->minimumBlockWidth;
-
-            if (i == minimumBlockHeightNumber - 1) {
-                blockHeightEnd = this->height;
-            }
-
-            if (j == minimumBlockWidthNumber - 1) {
-                blockWidthEnd = this->width;
+    
+    HistogramBinInvoker invoker(this, this->binLookup);
+    
+    if (this->numberOfThreads <= 1) {
+        invoker(cv::Range(0, this->height));
+    }
+    else {
+        cv::parallel_for_(cv::Range(0, this->height), invoker, this->numberOfThreads);
+    }
+    
+    #ifdef DEBUG
+        for (int i = 0; i < this->height; ++i) {
+            for (int j = 0; j < this->width; ++j) {
+                assert(this->histogramBins[i*this->stride + j] < this->histogramSize);
             }
+        }
+    #endif
+}
 
-            #ifdef DEBUG
-                assert(blockHeightEnd <= this->height);
-                assert(blockWidthEnd <= this->width);
-            #endif
-
-            for (int k = i*this->minimumBlockHeight; k < blockHeightEnd; ++k) {
-                for (int l = j*this->minimumBlockWidth; l < blockWidthEnd; ++l) {
-                    ++this->pixels[0][i][j];
-                    ++this->histograms[0][i][j][this->histogramBins[k][l]];
-                }
+/**
+ * Sum up N histograms into the given one, LANES bins at a time such that
+ * the inner loop can be vectorized. The histograms may use 16 or 32 bit bins.
+ * 
+ * @param T* histogram
+ * @param const S* const* histograms
+ * @param int length length of the histograms, a multiple of LANES
+ */
+template <typename T, typename S, int N>
+static inline void sumHistogramsN(T* histogram, const S* const* histograms, int length) {
+    const int LANES = HistogramIntersection::LANES;
+    
+    for (int k = 0; k < length; k += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+            int sum = histograms[0][k + l];
+            for (int n = 1; n < N; ++n) {
+                sum += histograms[n][k + l];
             }
+            
+            histogram[k + l] = sum;
         }
     }
+}
 
-    int blockHeightNumber;
-    int blockWidthNumber;
-    int blockHeightNumberBelow;
-    int blockWidthNumberBelow;
-
-    // Calculate histograms at the higher levels by accumulating the histograms
-    // at the levels below. First block level is level 1, so we start with level 2.
-
-    // Remember that the used index in this->histograms is on less than the level number.
-    for (int level = 2; level <= this->numberOfLevels; ++level) {
-        blockHeightNumber = this->getBlockHeightNumber(level);
-        blockWidthNumber = this->getBlockWidthNumber(level);
-        blockHeightNumberBelow = this->getBlockHeightNumber(level - 1);
-        blockWidthNumberBelow = this->getBlockWidthNumber(level - 1);
-
-        this->histograms[level - 1] = new int**[blockHeightNumber];
-        this->pixels[level - 1] = new int*[blockHeightNumber];
-
-        for (int i = 0; i < blockHeightNumber; ++i) {
-            this->histograms[level - 1][i] = new int*[blockWidthNumber];
-            this->pixels[level - 1][i] = new int[blockWidthNumber];
+/**
+ * Sum up count histograms into the given one; a block is made up of 2 x 2 
+ * blocks of the level below, at the borders of 2 x 3, 3 x 2 or 3 x 3 blocks.
+ * 
+ * @param T* histogram
+ * @param const S* const* histograms
+ * @param int count
+ * @param int length length of the histograms, a multiple of LANES
+ */
+template <typename T, typename S>
+static void sumHistograms(T* histogram, const S* const* histograms, int count, int length) {
+    switch (count) {
+        case 4:
+            sumHistogramsN<T, S, 4>(histogram, histograms, length);
+            break;
+        case 6:
+            sumHistogramsN<T, S, 6>(histogram, histograms, length);
+            break;
+        case 9:
+            sumHistogramsN<T, S, 9>(histogram, histograms, length);
+            break;
+        default:
+            std::fill(histogram, histogram + length, (T) 0);
+            for (int n = 0; n < count; ++n) {
+                for (int k = 0; k < length; ++k) {
+                    histogram[k] += histograms[n][k];
+                }
+            }
+            break;
+    }
+}
 
-            for (int j = 0; j < blockWidthNumber; ++j) {
-                this->histograms[level - 1][i][j] = new int[this->histogramSize];
+class SEEDSRevised::HistogramLevelInvoker : public cv::ParallelLoopBody {
+    
+public:
+    
+    HistogramLevelInvoker(SEEDSRevised* seeds, int level) 
+            : seeds(seeds), level(level) {
+        
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        std::vector<int> binCounts;
+        std::vector<int> countedBins;
+        
+        if (this->level <= this->seeds->numberOfSparseLevels) {
+            binCounts.assign(this->seeds->histogramSize, 0);
+        }
+        
+        for (int i = range.start; i < range.end; ++i) {
+            this->seeds->initializeHistogramRow(this->level, i, binCounts, countedBins);
+        }
+    }
+    
+private:
+    
+    SEEDSRevised* seeds;
+    int level;
+};
 
-                this->pixels[level - 1][i][j] = this->pixels[level - 2][2*i][2*j];
-                this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 1][2*j];
-                this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i][2*j + 1];
-                this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 1][2*j + 1];
+void SEEDSRevised::storeSparseHistogram(int level, int i, int j, std::vector<int> &binCounts, std::vector<int> &countedBins) {
+    SparseLevel &sparseLevel = this->sparseLevels[level - 1];
+    int index = i*this->levelWidthNumbers[level - 1] + j;
+    
+    unsigned short* bins = sparseLevel.bins + sparseLevel.offsets[index];
+    unsigned short* counts = sparseLevel.counts + sparseLevel.offsets[index];
+    
+    #ifdef DEBUG
+        assert((int) countedBins.size() <= this->getBlockArea(level, i, j));
+    #endif
+    
+    // Sorted bins access the superpixel histograms in order during block updates.
+    std::sort(countedBins.begin(), countedBins.end());
+    
+    for (unsigned int k = 0; k < countedBins.size(); ++k) {
+        bins[k] = countedBins[k];
+        counts[k] = binCounts[countedBins[k]];
+        binCounts[countedBins[k]] = 0;
+    }
+    
+    sparseLevel.lengths[index] = countedBins.size();
+    countedBins.clear();
+}
 
-                if (i == blockHeightNumber - 1 && 2*i + 2 < blockHeightNumberBelow) {
-                    this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 2][2*j];
-                    this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 2][2*j + 1];
-                }
+/**
+ * Count the given pixel bins into a histogram with 16 or 32 bit bins.
+ * 
+ * @param T* histogram
+ * @param const unsigned short* bins
+ * @param int begin
+ * @param int end exclusive
+ */
+template <typename T>
+static inline void countBins(T* histogram, const unsigned short* bins, int begin, int end) {
+    for (int l = begin; l < end; ++l) {
+        ++histogram[bins[l]];
+    }
+}
 
-                if (j == blockWidthNumber - 1 && 2*j + 2 < blockWidthNumberBelow) {
-                    this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i][2*j + 2];
-                    this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 1][2*j + 2];
-                }
+/**
+ * Add a sparse histogram to a histogram with 16 or 32 bit bins.
+ * 
+ * @param T* histogram
+ * @param const unsigned short* bins
+ * @param const unsigned short* counts
+ * @param int length
+ */
+template <typename T>
+static inline void addSparseHistogram(T* histogram, const unsigned short* bins, const unsigned short* counts, int length) {
+    for (int k = 0; k < length; ++k) {
+        histogram[bins[k]] += counts[k];
+    }
+}
 
-                if (i == blockHeightNumber - 1 && j == blockWidthNumber - 1
-                        && 2*i + 2 < blockHeightNumberBelow && 2*j + 2 < blockWidthNumberBelow) {
-                    this->pixels[level - 1][i][j] += this->pixels[level - 2][2*i + 2][2*j + 2];
+void SEEDSRevised::initializeHistogramRow(int level, int i, std::vector<int> &binCounts, std::vector<int> &countedBins) {
+    int blockHeightNumber = this->getBlockHeightNumber(level);
+    int blockWidthNumber = this->getBlockWidthNumber(level);
+    
+    if (level == 1 && level <= this->numberOfSparseLevels) {
+        int blockHeightEnd = (i + 1)*this->minimumBlockHeight;
+        if (i == blockHeightNumber - 1) {
+            blockHeightEnd = this->height;
+        }
+        
+        // Each block is counted separately as there is a single set of counts.
+        for (int j = 0; j < blockWidthNumber; ++j) {
+            int blockWidthEnd = (j + 1)*this->minimumBlockWidth;
+            if (j == blockWidthNumber - 1) {
+                blockWidthEnd = this->width;
+            }
+            
+            for (int k = i*this->minimumBlockHeight; k < blockHeightEnd; ++k) {
+                const unsigned short* bins = this->histogramBins + k*this->stride;
+                
+                for (int l = j*this->minimumBlockWidth; l < blockWidthEnd; ++l) {
+                    if (binCounts[bins[l]]++ == 0) {
+                        countedBins.push_back(bins[l]);
+                    }
+                }
+            }
+            
+            this->getPixels(1, i, j) = this->getBlockArea(1, i, j);
+            this->storeSparseHistogram(1, i, j, binCounts, countedBins);
+        }
+        
+        return;
+    }
+    
+    if (level == 1) {
+        // Remember the borders, blockHeightEnd is an exclusive index.
+        int blockHeightEnd = (i + 1)*this->minimumBlockHeight;
+        if (i == blockHeightNumber - 1) {
+            blockHeightEnd = this->height;
+        }
+        
+        #ifdef DEBUG
+            assert(blockHeightEnd <= this->height);
+        #endif
+        
+        bool narrow = (level <= this->numberOfNarrowLevels);
+        
+        // Also clears the padding of each histogram.
+        if (narrow) {
+            std::fill(this->getNarrowHistogram(1, i, 0), this->getNarrowHistogram(1, i, 0) + blockWidthNumber*this->histogramStride, 0);
+        }
+        else {
+            std::fill(this->getHistogram(1, i, 0), this->getHistogram(1, i, 0) + blockWidthNumber*this->histogramStride, 0);
+        }
+        
+        for (int j = 0; j < blockWidthNumber; ++j) {
+            this->getPixels(1, i, j) = 0;
+        }
+        
+        // The pixels are visited row by row, each row being divided among the blocks.
+        for (int k = i*this->minimumBlockHeight; k < blockHeightEnd; ++k) {
+            const unsigned short* bins = this->histogramBins + k*this->stride;
+            
+            for (int j = 0; j < blockWidthNumber; ++j) {
+                int blockWidthEnd = (j + 1)*this->minimumBlockWidth;
+                if (j == blockWidthNumber - 1) {
+                    blockWidthEnd = this->width;
+                }
+                
+                if (narrow) {
+                    countBins(this->getNarrowHistogram(1, i, j), bins, j*this->minimumBlockWidth, blockWidthEnd);
                 }
+                else {
+                    countBins(this->getHistogram(1, i, j), bins, j*this->minimumBlockWidth, blockWidthEnd);
+                }
+                
+                this->getPixels(1, i, j) += blockWidthEnd - j*this->minimumBlockWidth;
+            }
+        }
+        
+        return;
+    }
+    
+    // Remember that the used index in this->histograms is on less than the level number.
+    int blockHeightNumberBelow = this->getBlockHeightNumber(level - 1);
+    int blockWidthNumberBelow = this->getBlockWidthNumber(level - 1);
+    
+    // The last row and column of blocks may additionally cover
+    // a third row or column of blocks from the level below.
+    int iEnd = 2*i + 2;
+    if (i == blockHeightNumber - 1 && 2*i + 2 < blockHeightNumberBelow) {
+        iEnd = 2*i + 3;
+    }
+    
+    const int* histogramsBelow[9];
+    const unsigned short* narrowHistogramsBelow[9];
+    bool sparseBelow = (level - 1 <= this->numberOfSparseLevels);
+    bool narrowBelow = (level - 1 <= this->numberOfNarrowLevels);
+    
+    for (int j = 0; j < blockWidthNumber; ++j) {
+        int& blockPixels = this->getPixels(level, i, j);
+        
+        int jEnd = 2*j + 2;
+        if (j == blockWidthNumber - 1 && 2*j + 2 < blockWidthNumberBelow) {
+            jEnd = 2*j + 3;
+        }
+        
+        int count = 0;
+        blockPixels = 0;
+        
+        for (int iBelow = 2*i; iBelow < iEnd; ++iBelow) {
+            for (int jBelow = 2*j; jBelow < jEnd; ++jBelow) {
+                if (!narrowBelow) {
+                    histogramsBelow[count] = this->getHistogram(level - 1, iBelow, jBelow);
+                }
+                else if (!sparseBelow) {
+                    narrowHistogramsBelow[count] = this->getNarrowHistogram(level - 1, iBelow, jBelow);
+                }
+                
+                blockPixels += this->getPixels(level - 1, iBelow, jBelow);
+                ++count;
+            }
+        }
+        
+        if (sparseBelow) {
+            
+            // The sparse histograms below are summed up into the counts if this
+            // level is sparse as well, and into the dense histogram otherwise.
+            bool sparse = (level <= this->numberOfSparseLevels);
+            bool narrow = (level <= this->numberOfNarrowLevels);
+            
+            if (!narrow) {
+                std::fill(this->getHistogram(level, i, j), this->getHistogram(level, i, j) + this->histogramStride, 0);
+            }
+            else if (!sparse) {
+                std::fill(this->getNarrowHistogram(level, i, j), this->getNarrowHistogram(level, i, j) + this->histogramStride, 0);
+            }
+            
+            for (int iBelow = 2*i; iBelow < iEnd; ++iBelow) {
+                for (int jBelow = 2*j; jBelow < jEnd; ++jBelow) {
+                    const unsigned short* bins;
+                    const unsigned short* counts;
+                    int length = this->getSparseHistogram(level - 1, iBelow, jBelow, bins, counts);
+                    
+                    if (sparse) {
+                        for (int k = 0; k < length; ++k) {
+                            if (binCounts[bins[k]] == 0) {
+                                countedBins.push_back(bins[k]);
+                            }
+                            
+                            binCounts[bins[k]] += counts[k];
+                        }
+                    }
+                    else if (narrow) {
+                        addSparseHistogram(this->getNarrowHistogram(level, i, j), bins, counts, length);
+                    }
+                    else {
+                        addSparseHistogram(this->getHistogram(level, i, j), bins, counts, length);
+                    }
+                }
+            }
+            
+            if (sparse) {
+                this->storeSparseHistogram(level, i, j, binCounts, countedBins);
+            }
+            
+            continue;
+        }
+        
+        // The padding is zero in all histograms below, so it is summed up as well.
+        // Narrow levels are the lowest ones, so the level below is narrow as well.
+        if (level <= this->numberOfNarrowLevels) {
+            sumHistograms(this->getNarrowHistogram(level, i, j), narrowHistogramsBelow, count, this->histogramStride);
+        }
+        else if (narrowBelow) {
+            sumHistograms(this->getHistogram(level, i, j), narrowHistogramsBelow, count, this->histogramStride);
+        }
+        else {
+            sumHistograms(this->getHistogram(level, i, j), histogramsBelow, count, this->histogramStride);
+        }
+        
+        #ifdef DEBUG
+            assert(this->sumHistogram(level, i, j) == blockPixels);
+        #endif
+    }
+}
 
-                for (int k = 0; k < this->histogramSize; ++k) {
-                    this->histograms[level - 1][i][j][k] = this->histograms[level - 2][2*i][2*j][k];
-                    this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 1][2*j][k];
-                    this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i][2*j + 1][k];
-                    this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 1][2*j + 1][k];
+int SEEDSRevised::sumHistogram(int level, int i, int j) const {
+    int sum = 0;
+    
+    if (level <= this->numberOfSparseLevels) {
+        const unsigned short* bins;
+        const unsigned short* counts;
+        int length = this->getSparseHistogram(level, i, j, bins, counts);
+        
+        for (int k = 0; k < length; ++k) {
+            sum += counts[k];
+        }
+    }
+    else if (level <= this->numberOfNarrowLevels) {
+        const unsigned short* histogram = this->getNarrowHistogram(level, i, j);
+        
+        for (int k = 0; k < this->histogramSize; ++k) {
+            sum += histogram[k];
+        }
+    }
+    else {
+        const int* histogram = this->getHistogram(level, i, j);
+        
+        for (int k = 0; k < this->histogramSize; ++k) {
+            sum += histogram[k];
+        }
+    }
+    
+    return sum;
+}
 
-                    if (i == blockHeightNumber - 1 && 2*i + 2 < blockHeightNumberBelow) {
-                        this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 2][2*j][k];
-                        this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 2][2*j + 1][k];
-                    }
+void SEEDSRevised::initializeHistograms() {
+    this->histogramDimensions = this->image->channels();
+    
+    // The bins of the pixels are stored using 16 bits; checked at runtime as
+    // reset may have increased the number of channels.
+    CV_Assert(this->numberOfBins <= SEEDSRevised::getMaximumNumberOfBins(this->histogramDimensions));
+    
+    this->histogramSize = (int) pow(this->numberOfBins, this->histogramDimensions);
+    
+    // All histograms and pixel counts are stored in a single arena, the histograms
+    // are padded such that each of them is aligned, using 16 or 32 bit bins.
+    int alignment = SEEDSRevised::ALIGNMENT/sizeof(unsigned short);
+    this->histogramStride = ((this->histogramSize + alignment - 1)/alignment)*alignment;
+    
+    // The kernels in HistogramIntersection process the bins in groups of LANES.
+    assert(this->histogramStride % HistogramIntersection::LANES == 0);
+    
+    // A level may be stored sparsely if all its blocks have at most half as many
+    // pixels as there are bins, the blocks in the bottom right corner being the
+    // largest; as blocks grow with the level, these are the lowest levels.
+    this->numberOfSparseLevels = 0;
+    if (this->sparseHistograms == true) {
+        for (int level = 1; level < this->numberOfLevels; ++level) {
+            int maximumBlockArea = this->getBlockArea(level, this->getBlockHeightNumber(level) - 1, this->getBlockWidthNumber(level) - 1);
+            
+            if (2*maximumBlockArea > this->histogramSize) {
+                break;
+            }
+            
+            this->numberOfSparseLevels = level;
+        }
+    }
+    
+    // Counts of blocks with at most 65535 pixels fit into 16 bits; the superpixels
+    // change their size, so they always use 32 bits. Sparse levels are narrow as
+    // there are at most 65536 bins.
+    this->numberOfNarrowLevels = this->numberOfSparseLevels;
+    for (int level = this->numberOfSparseLevels + 1; level < this->numberOfLevels; ++level) {
+        int maximumBlockArea = this->getBlockArea(level, this->getBlockHeightNumber(level) - 1, this->getBlockWidthNumber(level) - 1);
+        
+        if (maximumBlockArea > 65535) {
+            break;
+        }
+        
+        this->numberOfNarrowLevels = level;
+    }
+    
+    size_t numberOfBlocks = 0;
+    size_t numberOfNarrowBlocks = 0;
+    size_t numberOfWideBlocks = 0;
+    for (int level = 1; level <= this->numberOfLevels; ++level) {
+        size_t levelBlocks = this->getBlockHeightNumber(level)*this->getBlockWidthNumber(level);
+        numberOfBlocks += levelBlocks;
+        
+        if (level > this->numberOfNarrowLevels) {
+            numberOfWideBlocks += levelBlocks;
+        }
+        else if (level > this->numberOfSparseLevels) {
+            numberOfNarrowBlocks += levelBlocks;
+        }
+    }
+    
+    // When initializing again, e.g. after reset, all arrays are reused; they are
+    // released whenever the image size or the configuration changes.
+    if (this->initializedHistograms == false) {
+        this->histogramBins = this->allocatePlane<unsigned short>(0);
+        
+        this->histograms = new int*[this->numberOfLevels];
+        this->narrowHistograms = new unsigned short*[this->numberOfLevels];
+        this->pixels = new int*[this->numberOfLevels];
+        this->levelWidthNumbers = new int[this->numberOfLevels];
+        
+        // The 16 bit histograms come first, a multiple of ALIGNMENT bytes each,
+        // followed by the 32 bit histograms and the pixel counts.
+        size_t narrowBytes = numberOfNarrowBlocks*this->histogramStride*sizeof(unsigned short);
+        size_t wideBytes = numberOfWideBlocks*this->histogramStride*sizeof(int);
+        this->histogramArena = SEEDSRevised::allocateAligned<unsigned char>(narrowBytes + wideBytes + numberOfBlocks*sizeof(int));
+        
+        unsigned short* narrowHistogramPointer = (unsigned short*) this->histogramArena;
+        int* histogramPointer = (int*) (this->histogramArena + narrowBytes);
+        int* pixelPointer = (int*) (this->histogramArena + narrowBytes + wideBytes);
 
-                    if (j == blockWidthNumber - 1 && 2*j + 2 < blockWidthNumberBelow) {
-                        this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i][2*j + 2][k];
-                        this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 1][2*j + 2][k];
-                    }
+        for (int level = 1; level <= this->numberOfLevels; ++level) {
+            this->levelWidthNumbers[level - 1] = this->getBlockWidthNumber(level);
+            int levelBlocks = this->getBlockHeightNumber(level)*this->levelWidthNumbers[level - 1];
 
-                    if (i == blockHeightNumber - 1 && j == blockWidthNumber - 1
-                            && 2*i + 2 < blockHeightNumberBelow && 2*j + 2 < blockWidthNumberBelow) {
-                        this->histograms[level - 1][i][j][k] += this->histograms[level - 2][2*i + 2][2*j + 2][k];
+            this->histograms[level - 1] = NULL;
+            this->narrowHistograms[level - 1] = NULL;
+            this->pixels[level - 1] = pixelPointer;
+            
+            if (level > this->numberOfNarrowLevels) {
+                this->histograms[level - 1] = histogramPointer;
+                histogramPointer += levelBlocks*this->histogramStride;
+            }
+            else if (level > this->numberOfSparseLevels) {
+                this->narrowHistograms[level - 1] = narrowHistogramPointer;
+                narrowHistogramPointer += levelBlocks*this->histogramStride;
+            }
+            
+            pixelPointer += levelBlocks;
+        }
+        
+        // The blocks of a level cover each pixel exactly once and a block has at
+        // most one non-empty bin per pixel, so each level needs one entry per pixel.
+        if (this->numberOfSparseLevels > 0) {
+            size_t levelEntries = this->height*this->width;
+            size_t numberOfSparseBlocks = numberOfBlocks - numberOfNarrowBlocks - numberOfWideBlocks;
+            
+            // Bins and counts use 16 bits, followed by the 32 bit offsets and lengths;
+            // the number of entries is even, so the latter stay aligned to 4 bytes.
+            size_t entryBytes = 2*this->numberOfSparseLevels*levelEntries*sizeof(unsigned short);
+            
+            this->sparseLevels = new SparseLevel[this->numberOfSparseLevels];
+            this->sparseArena = SEEDSRevised::allocateAligned<unsigned char>(entryBytes + 2*numberOfSparseBlocks*sizeof(int));
+            
+            unsigned short* entryPointer = (unsigned short*) this->sparseArena;
+            int* indexPointer = (int*) (this->sparseArena + entryBytes);
+            
+            for (int level = 1; level <= this->numberOfSparseLevels; ++level) {
+                SparseLevel &sparseLevel = this->sparseLevels[level - 1];
+                int blockHeightNumber = this->getBlockHeightNumber(level);
+                int blockWidthNumber = this->levelWidthNumbers[level - 1];
+                
+                sparseLevel.bins = entryPointer;
+                sparseLevel.counts = entryPointer + levelEntries;
+                sparseLevel.offsets = indexPointer;
+                sparseLevel.lengths = indexPointer + blockHeightNumber*blockWidthNumber;
+                
+                entryPointer += 2*levelEntries;
+                indexPointer += 2*blockHeightNumber*blockWidthNumber;
+                
+                int offset = 0;
+                for (int i = 0; i < blockHeightNumber; ++i) {
+                    for (int j = 0; j < blockWidthNumber; ++j) {
+                        sparseLevel.offsets[i*blockWidthNumber + j] = offset;
+                        offset += this->getBlockArea(level, i, j);
                     }
-
-                    #ifdef DEBUG
-                        assert(this->histograms[level - 1][i][j][k] <= this->pixels[level - 1][i][j]);
-                    #endif
                 }
             }
         }
     }
 
+    this->computeBinLookup();
+    this->computeHistogramBins();
+    this->buildHistograms();
+}
+
+void SEEDSRevised::buildHistograms() {
+    this->validPixelCache = false;
+    
+    // Level 1 is built from the pixels, each higher level from the level below;
+    // within a level, the rows of blocks are independent.
+    for (int level = 1; level <= this->numberOfLevels; ++level) {
+        HistogramLevelInvoker invoker(this, level);
+        int blockHeightNumber = this->getBlockHeightNumber(level);
+        
+        if (this->numberOfThreads <= 1) {
+            invoker(cv::Range(0, blockHeightNumber));
+        }
+        else {
+            cv::parallel_for_(cv::Range(0, blockHeightNumber), invoker, this->numberOfThreads);
+        }
+    }
+
     this->initializedHistograms = true;
 
     #ifdef DEBUG
     
         int blockWidth;
         int blockHeight;
+        int blockWidthNumber;
+        int blockHeightNumber;
 
         int sum = 0;
         for (int level = 1; level <= this->numberOfLevels; ++level) {
@@ -729,38 +1419,39 @@ void SEEDSRevised::initializeHistograms() {
 
             for (int i = 0; i < blockHeightNumber; ++i) {
                 for (int j = 0; j < blockWidthNumber; ++j) {
-                    sum = 0;
-                    for (int k = 0; k < this->histogramSize; ++k) {
-                        sum += this->histograms[level - 1][i][j][k];
-                    }
+                    sum = this->sumHistogram(level, i, j);
                     
-                    assert(this->pixels[level - 1][i][j] >= blockWidth*blockHeight);
-                    assert(this->pixels[level - 1][i][j] == sum);
+                    assert(this->getPixels(level, i, j) >= blockWidth*blockHeight);
+                    assert(this->getPixels(level, i, j) == sum);
                 }
             }
         }
     #endif
 }
 
-void SEEDSRevised::performBlockUpdate(int i, int j) {
+template <int SpatialMemoryMode>
+bool SEEDSRevised::proposeBlockUpdate(int i, int j, Update &update) {
 
-    if (this->spatialMemory[i][j] == true) {
+    if (this->spatialMemory.test(i, j)) {
         
-        #ifdef MEMORY
-            // Will be set to true i the case the block is moved.
-            this->spatialMemory[i][j] = false;
-        #endif
+        if (SpatialMemoryMode != NO_SPATIAL_MEMORY) {
+            // Will be set again in the case the block is moved.
+            this->spatialMemory.reset(i, j);
+        }
         
+        // Blocks only cover the upper left part of the label plane, so the indices
+        // are clamped to the current blocks at the bottom and the right, while the
+        // padded border of -1 labels is used at the top and the left.
         int iPlusOne = std::min(i + 1, this->currentBlockHeightNumber - 1);
-        int iMinusOne = std::max(i - 1, 0);
+        int iMinusOne = i - 1;
         int jPlusOne = std::min(j + 1, this->currentBlockWidthNumber - 1);
-        int jMinusOne = std::max(j - 1, 0);
+        int jMinusOne = j - 1;
 
-        int labelFrom = this->currentLabels[i][j];
-        int labelVerticalForward = this->currentLabels[iPlusOne][j];
-        int labelVerticalBackward = this->currentLabels[iMinusOne][j];
-        int labelHorizontalForward = this->currentLabels[i][jPlusOne];
-        int labelHorizontalBackward = this->currentLabels[i][jMinusOne];
+        int labelFrom = this->currentLabels[i*this->stride + j];
+        int labelVerticalForward = this->currentLabels[iPlusOne*this->stride + j];
+        int labelVerticalBackward = this->currentLabels[iMinusOne*this->stride + j];
+        int labelHorizontalForward = this->currentLabels[i*this->stride + jPlusOne];
+        int labelHorizontalBackward = this->currentLabels[i*this->stride + jMinusOne];
 
         if (labelVerticalForward != labelFrom
                 || labelVerticalBackward != labelFrom
@@ -770,123 +1461,537 @@ void SEEDSRevised::performBlockUpdate(int i, int j) {
             int iSuperpixelFrom = this->getSuperpixelIFromLabel(labelFrom);
             int jSuperpixelFrom = this->getSuperpixelJFromLabel(labelFrom);
 
-            int blocks = this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom]/this->pixels[this->currentLevel - 1][i][j];
+            int blocks = this->getPixels(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)/this->getPixels(this->currentLevel, i, j);
             if (blocks > this->minimumNumberOfSublabels) {
 
-                float currentScore = this->scoreCurrentBlockSegmentation(i, j, iSuperpixelFrom, jSuperpixelFrom);
-
+                // Directions in the order vertical forward, vertical backward,
+                // horizontal forward and horizontal backward.
+                int labels[4] = {labelVerticalForward, labelVerticalBackward, labelHorizontalForward, labelHorizontalBackward};
+                int iTo[4] = {iPlusOne, iMinusOne, i, i};
+                int jTo[4] = {j, j, jPlusOne, jMinusOne};
+                bool valid[4];
+                
+                valid[0] = labelVerticalForward != labelFrom && labelVerticalForward >= 0 && !this->checkSplitVerticalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+                valid[1] = labelVerticalBackward != labelFrom && labelVerticalBackward >= 0 && !this->checkSplitVerticalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+                valid[2] = labelHorizontalForward != labelFrom && labelHorizontalForward >= 0 && !this->checkSplitHorizontalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+                valid[3] = labelHorizontalBackward != labelFrom && labelHorizontalBackward >= 0 && !this->checkSplitHorizontalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+                
+                // The block is scored against its own superpixel (index 0) and all
+                // distinct candidate superpixels in a single pass over its histogram.
+                const int* histograms[HistogramIntersection::MAX_CANDIDATES + 1];
+                float reciprocals[HistogramIntersection::MAX_CANDIDATES + 1];
+                int candidateLabels[HistogramIntersection::MAX_CANDIDATES + 1];
+                int candidates[4];
+                int count = 1;
+                
+                float blockPixels = this->getPixels(this->currentLevel, i, j);
+                
+                histograms[0] = this->getHistogram(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom);
+                reciprocals[0] = 1.f/(this->getPixels(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom) - blockPixels);
+                candidateLabels[0] = labelFrom;
+                
+                for (int d = 0; d < 4; ++d) {
+                    if (!valid[d]) {
+                        continue;
+                    }
+                    
+                    candidates[d] = 1;
+                    while (candidates[d] < count && candidateLabels[candidates[d]] != labels[d]) {
+                        ++candidates[d];
+                    }
+                    
+                    if (candidates[d] == count) {
+                        int iSuperpixelTo = this->getSuperpixelIFromLabel(labels[d]);
+                        int jSuperpixelTo = this->getSuperpixelJFromLabel(labels[d]);
+                        
+                        histograms[count] = this->getHistogram(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo);
+                        reciprocals[count] = 1.f/this->getPixels(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo);
+                        candidateLabels[count] = labels[d];
+                        ++count;
+                    }
+                }
+                
+                if (count == 1) {
+                    return false;
+                }
+                
+                float scores[HistogramIntersection::MAX_CANDIDATES + 1];
+                if (this->currentLevel <= this->numberOfSparseLevels) {
+                    const unsigned short* bins;
+                    const unsigned short* counts;
+                    int length = this->getSparseHistogram(this->currentLevel, i, j, bins, counts);
+                    
+                    HistogramIntersection::intersectSparse(bins, counts, length, histograms, reciprocals, 
+                            count, 1.f/blockPixels, scores);
+                }
+                else if (this->currentLevel <= this->numberOfNarrowLevels) {
+                    this->narrowIntersectionKernel(this->getNarrowHistogram(this->currentLevel, i, j), histograms, reciprocals, 
+                            count, 1.f/blockPixels, this->histogramStride, scores);
+                }
+                else {
+                    this->intersectionKernel(this->getHistogram(this->currentLevel, i, j), histograms, reciprocals, 
+                            count, 1.f/blockPixels, this->histogramStride, scores);
+                }
+                
                 int iBest = i;
                 int jBest = j;
-                int iSuperpixelBest = iSuperpixelFrom;
-                int jSuperpixelBest = jSuperpixelFrom;
+                int labelBest = labelFrom;
                 float bestScore = 0.;
-
-                if (labelVerticalForward != labelFrom && !this->checkSplitVerticalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelVerticalForward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelVerticalForward);
-
-                    float proposedScore = this->scoreProposedBlockSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    
-                    if (proposedScore > currentScore + this->minimumConfidence && proposedScore > bestScore) {
-                        iBest = iPlusOne;
-                        jBest = j;
-                        iSuperpixelBest = iSuperpixelTo;
-                        jSuperpixelBest = jSuperpixelTo;
-                        bestScore = proposedScore;
+                
+                for (int d = 0; d < 4; ++d) {
+                    if (valid[d] && scores[candidates[d]] > scores[0] + this->minimumConfidence && scores[candidates[d]] > bestScore) {
+                        iBest = iTo[d];
+                        jBest = jTo[d];
+                        labelBest = labels[d];
+                        bestScore = scores[candidates[d]];
                     }
                 }
 
-                if (labelVerticalBackward != labelFrom && !this->checkSplitVerticalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelVerticalBackward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelVerticalBackward);
-                    
-                    float proposedScore = this->scoreProposedBlockSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+                if (bestScore > 0) {
+                    update.iFrom = i;
+                    update.jFrom = j;
+                    update.iTo = iBest;
+                    update.jTo = jBest;
+                    update.iSuperpixelFrom = iSuperpixelFrom;
+                    update.jSuperpixelFrom = jSuperpixelFrom;
+                    update.iSuperpixelTo = this->getSuperpixelIFromLabel(labelBest);
+                    update.jSuperpixelTo = this->getSuperpixelJFromLabel(labelBest);
+                    update.iPlusOne = iPlusOne;
+                    update.iMinusOne = iMinusOne;
+                    update.jPlusOne = jPlusOne;
+                    update.jMinusOne = jMinusOne;
                     
-                    if (proposedScore > currentScore + this->minimumConfidence && proposedScore > bestScore) {
-                        iBest = iMinusOne;
-                        jBest = j;
-                        iSuperpixelBest = iSuperpixelTo;
-                        jSuperpixelBest = jSuperpixelTo;
-                        bestScore = proposedScore;
-                    }
+                    return true;
                 }
+            }
+        }
+    }
+    
+    return false;
+}
 
-                if (labelHorizontalForward != labelFrom && !this->checkSplitHorizontalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelHorizontalForward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelHorizontalForward);
+bool SEEDSRevised::performBlockUpdate(int i, int j) {
+    switch (this->spatialMemoryMode) {
+        case NO_SPATIAL_MEMORY:
+            return this->performBlockUpdateUsing<NO_SPATIAL_MEMORY>(i, j);
+        case HEURISTIC_SPATIAL_MEMORY:
+            return this->performBlockUpdateUsing<HEURISTIC_SPATIAL_MEMORY>(i, j);
+        default:
+            return this->performBlockUpdateUsing<SPATIAL_MEMORY>(i, j);
+    }
+}
 
-                    float proposedScore = this->scoreProposedBlockSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    
-                    if (proposedScore > currentScore + this->minimumConfidence && proposedScore > bestScore) {
-                        iBest = i;
-                        jBest = jPlusOne;
-                        iSuperpixelBest = iSuperpixelTo;
-                        jSuperpixelBest = jSuperpixelTo;
-                        bestScore = proposedScore;
-                    }
+template <int SpatialMemoryMode>
+bool SEEDSRevised::performBlockUpdateUsing(int i, int j) {
+    Update update;
+    
+    if (this->proposeBlockUpdate<SpatialMemoryMode>(i, j, update)) {
+        this->updateBlock<SpatialMemoryMode>(update.iFrom, update.jFrom, update.iTo, update.jTo, 
+                update.iSuperpixelFrom, update.jSuperpixelFrom, update.iSuperpixelTo, update.jSuperpixelTo, 
+                update.iPlusOne, update.iMinusOne, update.jPlusOne, update.jMinusOne);
+        
+        return true;
+    }
+    
+    return false;
+}
+
+/**
+ * Proposes block updates for all blocks (iOffset + 3*k, jOffset + 3*l) with k
+ * in the given range. These blocks do not share any neighbors such that the
+ * proposals are independent of each other.
+ */
+template <int SpatialMemoryMode>
+class SEEDSRevised::BlockUpdateInvoker : public cv::ParallelLoopBody {
+    
+public:
+    
+    BlockUpdateInvoker(SEEDSRevised* seeds, int iOffset, int jOffset, int columns, Update* updates) 
+            : seeds(seeds), iOffset(iOffset), jOffset(jOffset), columns(columns), updates(updates) {
+        
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        for (int k = range.start; k < range.end; ++k) {
+            for (int l = 0; l < this->columns; ++l) {
+                Update &update = this->updates[k*this->columns + l];
+                update.valid = this->seeds->proposeBlockUpdate<SpatialMemoryMode>(this->iOffset + 3*k, this->jOffset + 3*l, update);
+            }
+        }
+    }
+    
+private:
+    
+    SEEDSRevised* seeds;
+    int iOffset;
+    int jOffset;
+    int columns;
+    Update* updates;
+};
+
+int SEEDSRevised::performBlockUpdates() {
+    switch (this->spatialMemoryMode) {
+        case NO_SPATIAL_MEMORY:
+            return this->performBlockUpdatesUsing<NO_SPATIAL_MEMORY>();
+        case HEURISTIC_SPATIAL_MEMORY:
+            return this->performBlockUpdatesUsing<HEURISTIC_SPATIAL_MEMORY>();
+        default:
+            return this->performBlockUpdatesUsing<SPATIAL_MEMORY>();
+    }
+}
+
+template <int SpatialMemoryMode>
+int SEEDSRevised::performBlockUpdatesUsing() {
+    int moves = 0;
+    
+    if (this->numberOfThreads <= 1) {
+        // Only blocks remembered in the spatial memory are visited.
+        for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
+            int end = this->currentBlockWidthNumber;
+            
+            for (int j = this->spatialMemory.next(i, 0, end); j < end; j = this->spatialMemory.next(i, j + 1, end)) {
+                if (this->performBlockUpdateUsing<SpatialMemoryMode>(i, j)) {
+                    ++moves;
+                }
+            }
+        }
+        
+        return moves;
+    }
+    
+    // A block update reads the labels of the 3 x 3 neighborhood of the block
+    // and only changes the label of the block itself. So the blocks are divided 
+    // into 9 classes according to (i % 3, j % 3) and the updates within one class 
+    // can be proposed in parallel. The accepted updates are then applied sequentially
+    // in a fixed order, such that the result does not depend on the number of threads.
+    for (int iOffset = 0; iOffset < 3; ++iOffset) {
+        for (int jOffset = 0; jOffset < 3; ++jOffset) {
+            int rows = (this->currentBlockHeightNumber - iOffset + 2)/3;
+            int columns = (this->currentBlockWidthNumber - jOffset + 2)/3;
+            
+            if (rows <= 0 || columns <= 0) {
+                continue;
+            }
+            
+            this->blockUpdates.resize(rows*columns);
+            cv::parallel_for_(cv::Range(0, rows), BlockUpdateInvoker<SpatialMemoryMode>(this, iOffset, jOffset, columns, &this->blockUpdates[0]), this->numberOfThreads);
+            
+            for (int k = 0; k < rows*columns; ++k) {
+                const Update &update = this->blockUpdates[k];
+                
+                if (update.valid == false) {
+                    continue;
+                }
+                
+                // Proposals within one class did not see each other, so make sure that
+                // the superpixel still keeps enough blocks.
+                int blocks = this->getPixels(this->numberOfLevels, update.iSuperpixelFrom, update.jSuperpixelFrom)/this->getPixels(this->currentLevel, update.iFrom, update.jFrom);
+                if (blocks > this->minimumNumberOfSublabels) {
+                    this->updateBlock<SpatialMemoryMode>(update.iFrom, update.jFrom, update.iTo, update.jTo, 
+                            update.iSuperpixelFrom, update.jSuperpixelFrom, update.iSuperpixelTo, update.jSuperpixelTo, 
+                            update.iPlusOne, update.iMinusOne, update.jPlusOne, update.jMinusOne);
+                    ++moves;
+                }
+            }
+        }
+    }
+    
+    return moves;
+}
+
+
+/**
+ * Pixel updates for the given pixel policy, see HistogramPixelPolicy and MeanPixelPolicy,
+ * and the given spatial memory mode, see SEEDSRevised::setSpatialMemoryMode.
+ * As both are template parameters, scoring and updating pixels is resolved
+ * at compile time and can be inlined into the sweeps over all pixels.
+ */
+template <class PixelPolicy, int SpatialMemoryMode>
+class SEEDSEngine {
+    
+public:
+    
+    /**
+     * Constructor, cheap as the cached statistics of the policy are kept by
+     * the segmenter, see validateCache.
+     */
+    SEEDSEngine(SEEDSRevised* seeds, const PixelPolicy &policy) 
+            : seeds(seeds), policy(policy) {
+        
+    }
+    
+    /**
+     * Recompute the cached statistics of the policy and the smoothing prior
+     * counts of sequential pixel updates if labels or superpixels changed
+     * since the last pixel updates, e.g. by block updates or initialization;
+     * otherwise, they are kept up to date by the pixel updates themselves.
+     */
+    inline void validateCache() {
+        if (this->seeds->validPixelCache == false) {
+            this->policy.initializeCache();
+            this->resetNeighborhood(this->seeds->neighborhoodCounts);
+            this->seeds->validPixelCache = true;
+        }
+    }
+    
+    /**
+     * Find the best update for the given pixel without applying it, see
+     * SEEDSRevised::proposeBlockUpdate.
+     * 
+     * @param int i
+     * @param int j
+     * @param Update update the best update if there is one
+     * @param NeighborhoodCounts neighborhood smoothing prior counts of the current sweep
+     * @return whether the pixel should be moved
+     */
+    bool proposePixelUpdate(int i, int j, SEEDSRevised::Update &update, SEEDSRevised::NeighborhoodCounts &neighborhood);
+    
+    /**
+     * Remove the window of the given counts, needed whenever labels were changed
+     * outside of the sweep the counts are used for.
+     * 
+     * @param NeighborhoodCounts neighborhood
+     */
+    inline void resetNeighborhood(SEEDSRevised::NeighborhoodCounts &neighborhood) {
+        if (this->seeds->neighborhoodSize > 0) {
+            neighborhood.counts.assign(this->seeds->superpixelHeightNumber*this->seeds->superpixelWidthNumber, 0);
+            neighborhood.labels.clear();
+            neighborhood.i = -1;
+            neighborhood.j = -1;
+        }
+    }
+    
+    /**
+     * Move the window of the given counts to pixel (i, j). Within a row, the
+     * window is shifted column by column, otherwise it is counted again.
+     * 
+     * @param int i
+     * @param int j
+     * @param NeighborhoodCounts neighborhood
+     */
+    void moveNeighborhood(int i, int j, SEEDSRevised::NeighborhoodCounts &neighborhood);
+    
+    /**
+     * Count the pixels of the given superpixels within the neighborhood used
+     * for the smoothing prior when moving pixel (i, j) towards pixel (iTo, jTo):
+     * the window around (i, j) extended by one row or column towards (iTo, jTo).
+     * 
+     * @param int i
+     * @param int j
+     * @param int iTo
+     * @param int jTo
+     * @param int labelFrom
+     * @param int labelTo
+     * @param NeighborhoodCounts neighborhood
+     * @param int countFrom
+     * @param int countTo
+     */
+    inline void countNeighborhood(int i, int j, int iTo, int jTo, int labelFrom, int labelTo, SEEDSRevised::NeighborhoodCounts &neighborhood, int &countFrom, int &countTo) {
+        SEEDSRevised* seeds = this->seeds;
+        int neighborhoodSize = seeds->neighborhoodSize;
+        
+        countFrom = 0;
+        countTo = 0;
+        
+        if (neighborhoodSize <= 0) {
+            return;
+        }
+        
+        if (neighborhood.i != i || neighborhood.j != j) {
+            this->moveNeighborhood(i, j, neighborhood);
+        }
+        
+        countFrom = neighborhood.counts[labelFrom];
+        countTo = neighborhood.counts[labelTo];
+        
+        if (iTo != i) {
+            int iEdge = (iTo > i ? i + neighborhoodSize + 1 : i - neighborhoodSize - 1);
+            
+            if (iEdge >= 0 && iEdge < seeds->height) {
+                const int* labels = seeds->currentLabels + iEdge*seeds->stride;
+                int jEnd = std::min(seeds->width, j + neighborhoodSize + 1);
+                
+                for (int jEdge = std::max(0, j - neighborhoodSize); jEdge < jEnd; ++jEdge) {
+                    countFrom += (labels[jEdge] == labelFrom);
+                    countTo += (labels[jEdge] == labelTo);
                 }
-
-                if (labelHorizontalBackward != labelFrom && !this->checkSplitHorizontalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelHorizontalBackward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelHorizontalBackward);
-
-                    float proposedScore = this->scoreProposedBlockSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+            }
+        }
+        else {
+            int jEdge = (jTo > j ? j + neighborhoodSize + 1 : j - neighborhoodSize - 1);
+            
+            if (jEdge >= 0 && jEdge < seeds->width) {
+                int iEnd = std::min(seeds->height, i + neighborhoodSize + 1);
+                
+                for (int iEdge = std::max(0, i - neighborhoodSize); iEdge < iEnd; ++iEdge) {
+                    int label = seeds->currentLabels[iEdge*seeds->stride + jEdge];
                     
-                    if (proposedScore > currentScore + this->minimumConfidence && proposedScore > bestScore) {
-                        iBest = i;
-                        jBest = jMinusOne;
-                        iSuperpixelBest = iSuperpixelTo;
-                        jSuperpixelBest = jSuperpixelTo;
-                        bestScore = proposedScore;
-                    }
+                    countFrom += (label == labelFrom);
+                    countTo += (label == labelTo);
                 }
-
-                if (bestScore > 0) {
-                    this->updateBlock(i, j, iBest, jBest, iSuperpixelFrom, jSuperpixelFrom, iSuperpixelBest, jSuperpixelBest, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+            }
+        }
+    }
+    
+    /**
+     * Keep the counts consistent after the pixel in the center of the window
+     * has been moved.
+     * 
+     * @param Update update
+     * @param NeighborhoodCounts neighborhood
+     */
+    inline void updateNeighborhood(const SEEDSRevised::Update &update, SEEDSRevised::NeighborhoodCounts &neighborhood) {
+        if (this->seeds->neighborhoodSize > 0) {
+            #ifdef DEBUG
+                assert(neighborhood.i == update.iFrom && neighborhood.j == update.jFrom);
+            #endif
+            
+            int labelTo = update.iSuperpixelTo*this->seeds->superpixelWidthNumber + update.jSuperpixelTo;
+            
+            --neighborhood.counts[update.iSuperpixelFrom*this->seeds->superpixelWidthNumber + update.jSuperpixelFrom];
+            if (neighborhood.counts[labelTo]++ == 0) {
+                neighborhood.labels.push_back(labelTo);
+            }
+        }
+    }
+    
+    /**
+     * Assign the given pixel to the new superpixel.
+     * 
+     * @param Update update
+     */
+    inline void updatePixel(const SEEDSRevised::Update &update) {
+        this->seeds->currentLabels[update.iFrom*this->seeds->stride + update.jFrom] = this->seeds->currentLabels[update.iTo*this->seeds->stride + update.jTo];
+        this->seeds->updateBoundaries(update.iFrom, update.jFrom);
+        
+        this->policy.updatePixelStatistics(update.iFrom, update.jFrom, update.iSuperpixelFrom, update.jSuperpixelFrom, update.iSuperpixelTo, update.jSuperpixelTo);
+        this->seeds->updateSpatialMemory<SpatialMemoryMode>(update.iFrom, update.jFrom, update.iPlusOne, update.iMinusOne, update.jPlusOne, update.jMinusOne);
+    }
+    
+    /**
+     * Perform a pixel update for the given pixel.
+     * 
+     * @param int i
+     * @param int j
+     */
+    inline bool performPixelUpdate(int i, int j) {
+        SEEDSRevised::Update update;
+        
+        if (this->proposePixelUpdate(i, j, update, this->seeds->neighborhoodCounts)) {
+            this->updatePixel(update);
+            this->updateNeighborhood(update, this->seeds->neighborhoodCounts);
+            return true;
+        }
+        
+        return false;
+    }
+    
+    /**
+     * Perform one iteration of pixel updates, see SEEDSRevised::performPixelUpdates.
+     * 
+     * @return int number of pixels moved
+     */
+    int performPixelUpdates();
+    
+private:
+    
+    /**
+     * Performs pixel updates for a set of strips in parallel.
+     */
+    class PixelUpdateInvoker;
+    
+    SEEDSRevised* seeds;
+    PixelPolicy policy;
+};
+
+template <class PixelPolicy, int SpatialMemoryMode>
+void SEEDSEngine<PixelPolicy, SpatialMemoryMode>::moveNeighborhood(int i, int j, SEEDSRevised::NeighborhoodCounts &neighborhood) {
+    SEEDSRevised* seeds = this->seeds;
+    int neighborhoodSize = seeds->neighborhoodSize;
+    
+    int iStart = std::max(0, i - neighborhoodSize);
+    int iEnd = std::min(seeds->height, i + neighborhoodSize + 1);
+    
+    // Shifting costs two columns per step, counting the window again costs
+    // all its columns.
+    if (neighborhood.i == i && neighborhood.j < j && j - neighborhood.j <= neighborhoodSize) {
+        for (int jCenter = neighborhood.j + 1; jCenter <= j; ++jCenter) {
+            int jOut = jCenter - neighborhoodSize - 1;
+            int jIn = jCenter + neighborhoodSize;
+            
+            for (int iWindow = iStart; iWindow < iEnd; ++iWindow) {
+                const int* labels = seeds->currentLabels + iWindow*seeds->stride;
+                
+                if (jOut >= 0) {
+                    --neighborhood.counts[labels[jOut]];
+                }
+                
+                if (jIn < seeds->width && neighborhood.counts[labels[jIn]]++ == 0) {
+                    neighborhood.labels.push_back(labels[jIn]);
+                }
+            }
+        }
+    }
+    else {
+        for (unsigned int k = 0; k < neighborhood.labels.size(); ++k) {
+            neighborhood.counts[neighborhood.labels[k]] = 0;
+        }
+        
+        neighborhood.labels.clear();
+        
+        int jStart = std::max(0, j - neighborhoodSize);
+        int jEnd = std::min(seeds->width, j + neighborhoodSize + 1);
+        
+        for (int iWindow = iStart; iWindow < iEnd; ++iWindow) {
+            const int* labels = seeds->currentLabels + iWindow*seeds->stride;
+            
+            for (int jWindow = jStart; jWindow < jEnd; ++jWindow) {
+                if (neighborhood.counts[labels[jWindow]]++ == 0) {
+                    neighborhood.labels.push_back(labels[jWindow]);
                 }
             }
         }
     }
+    
+    neighborhood.i = i;
+    neighborhood.j = j;
 }
 
-void SEEDSRevised::performPixelUpdate(int i, int j) {
+template <class PixelPolicy, int SpatialMemoryMode>
+bool SEEDSEngine<PixelPolicy, SpatialMemoryMode>::proposePixelUpdate(int i, int j, SEEDSRevised::Update &update, SEEDSRevised::NeighborhoodCounts &neighborhood) {
+    SEEDSRevised* seeds = this->seeds;
     
-    if (this->spatialMemory[i][j] == true) {
+    if (seeds->spatialMemory.test(i, j)) {
         
-        #ifdef MEMORY
-            // Will be set to true in the case the pixel is moved.
-            this->spatialMemory[i][j] = false;
-        #endif
+        if (SpatialMemoryMode != SEEDSRevised::NO_SPATIAL_MEMORY) {
+            // Will be set again in the case the pixel is moved.
+            seeds->spatialMemory.reset(i, j);
+        }
             
-        int iPlusOne = std::min(i + 1, this->height - 1);
-        int iMinusOne = std::max(i - 1, 0);
-        int jPlusOne = std::min(j + 1, this->width - 1);
-        int jMinusOne = std::max(j - 1, 0);
-
-        int labelFrom = this->currentLabels[i][j];
-        int labelVerticalForward = this->currentLabels[iPlusOne][j];
-        int labelVerticalBackward = this->currentLabels[iMinusOne][j];
-        int labelHorizontalForward = this->currentLabels[i][jPlusOne];
-        int labelHorizontalBackward = this->currentLabels[i][jMinusOne];
-
-        #ifdef DEBUG
-            assert(labelVerticalForward >= 0);
-            assert(labelVerticalBackward >= 0);
-            assert(labelHorizontalForward >= 0);
-            assert(labelHorizontalBackward >= 0);
-        #endif
+        // The label plane is padded with -1 labels, so no clamping is needed.
+        int iPlusOne = i + 1;
+        int iMinusOne = i - 1;
+        int jPlusOne = j + 1;
+        int jMinusOne = j - 1;
+
+        const int* labels = seeds->currentLabels + i*seeds->stride + j;
+        int labelFrom = labels[0];
+        int labelVerticalForward = labels[seeds->stride];
+        int labelVerticalBackward = labels[-seeds->stride];
+        int labelHorizontalForward = labels[1];
+        int labelHorizontalBackward = labels[-1];
 
         if (labelVerticalForward != labelFrom
                 || labelVerticalBackward != labelFrom
                 || labelHorizontalForward != labelFrom
                 || labelHorizontalBackward != labelFrom) {
 
-            int iSuperpixelFrom = this->getSuperpixelIFromLabel(labelFrom);
-            int jSuperpixelFrom = this->getSuperpixelJFromLabel(labelFrom);
+            int iSuperpixelFrom = seeds->getSuperpixelIFromLabel(labelFrom);
+            int jSuperpixelFrom = seeds->getSuperpixelJFromLabel(labelFrom);
 
-            if (this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] > this->minimumNumberOfSublabels) {
+            if (seeds->getPixels(seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom) > seeds->minimumNumberOfSublabels) {
 
-                float currentScore = this->scoreCurrentPixelSegmentation(i, j, iSuperpixelFrom, jSuperpixelFrom);
+                float currentScore = this->policy.scoreCurrentPixelSegmentation(i, j, iSuperpixelFrom, jSuperpixelFrom);
 
                 int iBest = i;
                 int jBest = j;
@@ -894,12 +1999,16 @@ void SEEDSRevised::performPixelUpdate(int i, int j) {
                 int jSuperpixelBest = jSuperpixelFrom;
                 float bestScore = 0.;
 
-                if (labelVerticalForward != labelFrom && !this->checkSplitVerticalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelVerticalForward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelVerticalForward);
+                if (labelVerticalForward != labelFrom && labelVerticalForward >= 0 && !seeds->checkSplitVerticalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
+                    int iSuperpixelTo = seeds->getSuperpixelIFromLabel(labelVerticalForward);
+                    int jSuperpixelTo = seeds->getSuperpixelJFromLabel(labelVerticalForward);
 
-                    float proposedScore = this->scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    float score = this->scorePixelUpdate(i, j, iPlusOne, j, currentScore, proposedScore);
+                    float proposedScore = this->policy.scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+                    int countFrom;
+                    int countTo;
+                    this->countNeighborhood(i, j, iPlusOne, j, labelFrom, labelVerticalForward, neighborhood, countFrom, countTo);
+                    
+                    float score = this->policy.scorePixelUpdate(countFrom, countTo, currentScore, proposedScore);
 
                     if (score > 0 && score > bestScore) {
                         iBest = iPlusOne;
@@ -910,12 +2019,16 @@ void SEEDSRevised::performPixelUpdate(int i, int j) {
                     }
                 }
 
-                if (labelVerticalBackward != labelFrom && !this->checkSplitVerticalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelVerticalBackward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelVerticalBackward);
+                if (labelVerticalBackward != labelFrom && labelVerticalBackward >= 0 && !seeds->checkSplitVerticalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
+                    int iSuperpixelTo = seeds->getSuperpixelIFromLabel(labelVerticalBackward);
+                    int jSuperpixelTo = seeds->getSuperpixelJFromLabel(labelVerticalBackward);
 
-                    float proposedScore = this->scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    float score = this->scorePixelUpdate(i, j, iMinusOne, j, currentScore, proposedScore);
+                    float proposedScore = this->policy.scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+                    int countFrom;
+                    int countTo;
+                    this->countNeighborhood(i, j, iMinusOne, j, labelFrom, labelVerticalBackward, neighborhood, countFrom, countTo);
+                    
+                    float score = this->policy.scorePixelUpdate(countFrom, countTo, currentScore, proposedScore);
 
                     if (score > 0 && score > bestScore) {
                         iBest = iMinusOne;
@@ -926,12 +2039,16 @@ void SEEDSRevised::performPixelUpdate(int i, int j) {
                     }
                 }
 
-                if (labelHorizontalForward != labelFrom && !this->checkSplitHorizontalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelHorizontalForward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelHorizontalForward);
+                if (labelHorizontalForward != labelFrom && labelHorizontalForward >= 0 && !seeds->checkSplitHorizontalForward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
+                    int iSuperpixelTo = seeds->getSuperpixelIFromLabel(labelHorizontalForward);
+                    int jSuperpixelTo = seeds->getSuperpixelJFromLabel(labelHorizontalForward);
 
-                    float proposedScore = this->scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    float score = this->scorePixelUpdate(i, j, i, jPlusOne, currentScore, proposedScore);
+                    float proposedScore = this->policy.scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+                    int countFrom;
+                    int countTo;
+                    this->countNeighborhood(i, j, i, jPlusOne, labelFrom, labelHorizontalForward, neighborhood, countFrom, countTo);
+                    
+                    float score = this->policy.scorePixelUpdate(countFrom, countTo, currentScore, proposedScore);
 
                     if (score > 0 && score > bestScore) {
                         iBest = i;
@@ -942,12 +2059,16 @@ void SEEDSRevised::performPixelUpdate(int i, int j) {
                     }
                 }
 
-                if (labelHorizontalBackward != labelFrom && !this->checkSplitHorizontalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
-                    int iSuperpixelTo = this->getSuperpixelIFromLabel(labelHorizontalBackward);
-                    int jSuperpixelTo = this->getSuperpixelJFromLabel(labelHorizontalBackward);
+                if (labelHorizontalBackward != labelFrom && labelHorizontalBackward >= 0 && !seeds->checkSplitHorizontalBackward(i, j, iPlusOne, iMinusOne, jPlusOne, jMinusOne)) {
+                    int iSuperpixelTo = seeds->getSuperpixelIFromLabel(labelHorizontalBackward);
+                    int jSuperpixelTo = seeds->getSuperpixelJFromLabel(labelHorizontalBackward);
 
-                    float proposedScore = this->scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
-                    float score = this->scorePixelUpdate(i, j, i, jMinusOne, currentScore, proposedScore);
+                    float proposedScore = this->policy.scoreProposedPixelSegmentation(i, j, iSuperpixelTo, jSuperpixelTo);
+                    int countFrom;
+                    int countTo;
+                    this->countNeighborhood(i, j, i, jMinusOne, labelFrom, labelHorizontalBackward, neighborhood, countFrom, countTo);
+                    
+                    float score = this->policy.scorePixelUpdate(countFrom, countTo, currentScore, proposedScore);
 
                     if (score > 0 && score > bestScore) {
                         iBest = i;
@@ -959,43 +2080,295 @@ void SEEDSRevised::performPixelUpdate(int i, int j) {
                 }
 
                 if (bestScore > 0) {
-                    this->updatePixel(i, j, iBest, jBest, iSuperpixelFrom, jSuperpixelFrom, iSuperpixelBest, jSuperpixelBest, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+                    update.iFrom = i;
+                    update.jFrom = j;
+                    update.iTo = iBest;
+                    update.jTo = jBest;
+                    update.iSuperpixelFrom = iSuperpixelFrom;
+                    update.jSuperpixelFrom = jSuperpixelFrom;
+                    update.iSuperpixelTo = iSuperpixelBest;
+                    update.jSuperpixelTo = jSuperpixelBest;
+                    update.iPlusOne = iPlusOne;
+                    update.iMinusOne = iMinusOne;
+                    update.jPlusOne = jPlusOne;
+                    update.jMinusOne = jMinusOne;
+                    
+                    return true;
                 }
             }
         }
     }
+    
+    return false;
 }
 
-void SEEDSRevised::iterate(int iterations) {
+/**
+ * Performs pixel updates for the strips 2*k + offset with k in the given range.
+ * Labels and spatial memory are updated immediately, while the superpixel
+ * histograms are left untouched and the updates are collected per strip.
+ */
+template <class PixelPolicy, int SpatialMemoryMode>
+class SEEDSEngine<PixelPolicy, SpatialMemoryMode>::PixelUpdateInvoker : public cv::ParallelLoopBody {
     
-    while (this->currentLevel > 0) {
+public:
+    
+    PixelUpdateInvoker(SEEDSEngine* engine, int offset, int activeStrips) 
+            : engine(engine), offset(offset), activeStrips(activeStrips) {
         
-        this->reinitializeSpatialMemory();
-        for (int iteration = 0; iteration < iterations; ++iteration) {
-            for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
-                for (int j = 0; j < this->currentBlockWidthNumber; ++j) {
-                    this->performBlockUpdate(i, j);
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        SEEDSRevised* seeds = this->engine->seeds;
+        
+        for (int k = range.start; k < range.end; ++k) {
+            SEEDSRevised::PixelStrip &strip = seeds->pixelStrips[2*k + this->offset];
+            
+            for (int i = strip.iStart; i < strip.iEnd; ++i) {
+                for (int j = seeds->spatialMemory.next(i, 0, seeds->width, seeds->boundary); j < seeds->width; j = seeds->spatialMemory.next(i, j + 1, seeds->width, seeds->boundary)) {
+                    SEEDSRevised::Update update;
+                    
+                    if (!this->engine->proposePixelUpdate(i, j, update, strip.neighborhood)) {
+                        continue;
+                    }
+                    
+                    // The pixel counts are not updated until all strips are done,
+                    // so each strip may only remove its share of pixels from a superpixel
+                    // to ensure that every superpixel keeps enough pixels.
+                    int labelFrom = seeds->currentLabels[i*seeds->stride + j];
+                    int pixels = seeds->getPixels(seeds->numberOfLevels, update.iSuperpixelFrom, update.jSuperpixelFrom);
+                    
+                    if (pixels + this->activeStrips*(strip.pixelDeltas[labelFrom] - 1) <= seeds->minimumNumberOfSublabels) {
+                        continue;
+                    }
+                    
+                    int labelTo = seeds->currentLabels[update.iTo*seeds->stride + update.jTo];
+                    seeds->currentLabels[i*seeds->stride + j] = labelTo;
+                    seeds->updateBoundaries(i, j);
+                    seeds->updateSpatialMemory<SpatialMemoryMode>(i, j, update.iPlusOne, update.iMinusOne, update.jPlusOne, update.jMinusOne);
+                    
+                    this->engine->updateNeighborhood(update, strip.neighborhood);
+                    
+                    --strip.pixelDeltas[labelFrom];
+                    ++strip.pixelDeltas[labelTo];
+                    strip.updates.push_back(update);
+                }
+            }
+        }
+    }
+    
+private:
+    
+    SEEDSEngine* engine;
+    int offset;
+    int activeStrips;
+};
+
+template <class PixelPolicy, int SpatialMemoryMode>
+int SEEDSEngine<PixelPolicy, SpatialMemoryMode>::performPixelUpdates() {
+    SEEDSRevised* seeds = this->seeds;
+    int moves = 0;
+    
+    this->validateCache();
+    
+    // Pixel updates read the labels within neighborhoodSize + 1 rows, so strips
+    // need to be higher than that to separate the strips updated in parallel.
+    int minimumStripHeight = seeds->neighborhoodSize + 2;
+    int numberOfStrips = std::min(2*seeds->numberOfThreads, seeds->height/minimumStripHeight);
+    
+    if (seeds->numberOfThreads <= 1 || numberOfStrips < 2) {
+        // Only pixels on a boundary and remembered in the spatial memory are visited.
+        for (int i = 0; i < seeds->height; ++i) {
+            for (int j = seeds->spatialMemory.next(i, 0, seeds->width, seeds->boundary); j < seeds->width; j = seeds->spatialMemory.next(i, j + 1, seeds->width, seeds->boundary)) {
+                if (this->performPixelUpdate(i, j)) {
+                    ++moves;
                 }
             }
         }
         
-        this->goDownOneLevel();
+        return moves;
+    }
+    
+    seeds->pixelStrips.resize(numberOfStrips);
+    for (int k = 0; k < numberOfStrips; ++k) {
+        seeds->pixelStrips[k].iStart = (k*seeds->height)/numberOfStrips;
+        seeds->pixelStrips[k].iEnd = ((k + 1)*seeds->height)/numberOfStrips;
     }
+    
+    // First all even strips are updated in parallel, separated by the odd strips,
+    // then all odd strips. After each pass, the collected updates are applied 
+    // to the superpixel histograms in a fixed order.
+    for (int offset = 0; offset < 2; ++offset) {
+        int activeStrips = (numberOfStrips - offset + 1)/2;
         
-    this->reinitializeSpatialMemory();
-    for (int iteration = 0; iteration < 2*iterations; ++iteration) {
-        for (int i = 0; i < this->height; ++i) {
-            for (int j = 0; j < this->width; ++j) {
-                this->performPixelUpdate(i, j);
+        for (int k = offset; k < numberOfStrips; k += 2) {
+            seeds->pixelStrips[k].updates.clear();
+            seeds->pixelStrips[k].pixelDeltas.assign(seeds->superpixelWidthNumber*seeds->superpixelHeightNumber, 0);
+            this->resetNeighborhood(seeds->pixelStrips[k].neighborhood);
+        }
+        
+        cv::parallel_for_(cv::Range(0, activeStrips), PixelUpdateInvoker(this, offset, activeStrips), seeds->numberOfThreads);
+        
+        for (int k = offset; k < numberOfStrips; k += 2) {
+            const std::vector<SEEDSRevised::Update> &updates = seeds->pixelStrips[k].updates;
+            moves += updates.size();
+            
+            for (unsigned int l = 0; l < updates.size(); ++l) {
+                this->policy.updatePixelStatistics(updates[l].iFrom, updates[l].jFrom, updates[l].iSuperpixelFrom, updates[l].jSuperpixelFrom, updates[l].iSuperpixelTo, updates[l].jSuperpixelTo);
             }
         }
     }
+    
+    // The strips changed labels within the window of sequential pixel updates.
+    this->resetNeighborhood(seeds->neighborhoodCounts);
+    
+    return moves;
+}
+
+/**
+ * Perform a pixel update for the given pixel using the engine for the given
+ * policy and spatial memory mode; the cached statistics are only recomputed
+ * if labels or superpixels changed since the last pixel update.
+ * 
+ * @param SEEDSRevised* seeds
+ * @param PixelPolicy policy
+ * @param int i
+ * @param int j
+ */
+template <class PixelPolicy, int SpatialMemoryMode>
+static void performPixelUpdateUsing(SEEDSRevised* seeds, const PixelPolicy &policy, int i, int j) {
+    SEEDSEngine<PixelPolicy, SpatialMemoryMode> engine(seeds, policy);
+    
+    engine.validateCache();
+    engine.performPixelUpdate(i, j);
+}
+
+/**
+ * Perform a pixel update for the given pixel using the spatial memory mode
+ * of the given segmenter.
+ * 
+ * @param SEEDSRevised* seeds
+ * @param PixelPolicy policy
+ * @param int i
+ * @param int j
+ */
+template <class PixelPolicy>
+static void dispatchPixelUpdate(SEEDSRevised* seeds, const PixelPolicy &policy, int i, int j) {
+    switch (seeds->getSpatialMemoryMode()) {
+        case SEEDSRevised::NO_SPATIAL_MEMORY:
+            performPixelUpdateUsing<PixelPolicy, SEEDSRevised::NO_SPATIAL_MEMORY>(seeds, policy, i, j);
+            break;
+        case SEEDSRevised::HEURISTIC_SPATIAL_MEMORY:
+            performPixelUpdateUsing<PixelPolicy, SEEDSRevised::HEURISTIC_SPATIAL_MEMORY>(seeds, policy, i, j);
+            break;
+        default:
+            performPixelUpdateUsing<PixelPolicy, SEEDSRevised::SPATIAL_MEMORY>(seeds, policy, i, j);
+            break;
+    }
+}
+
+/**
+ * Perform one iteration of pixel updates using the engine for the given policy
+ * and the spatial memory mode of the given segmenter.
+ * 
+ * @param SEEDSRevised* seeds
+ * @param PixelPolicy policy
+ * @return int number of pixels moved
+ */
+template <class PixelPolicy>
+static int dispatchPixelUpdates(SEEDSRevised* seeds, const PixelPolicy &policy) {
+    switch (seeds->getSpatialMemoryMode()) {
+        case SEEDSRevised::NO_SPATIAL_MEMORY:
+            return SEEDSEngine<PixelPolicy, SEEDSRevised::NO_SPATIAL_MEMORY>(seeds, policy).performPixelUpdates();
+        case SEEDSRevised::HEURISTIC_SPATIAL_MEMORY:
+            return SEEDSEngine<PixelPolicy, SEEDSRevised::HEURISTIC_SPATIAL_MEMORY>(seeds, policy).performPixelUpdates();
+        default:
+            return SEEDSEngine<PixelPolicy, SEEDSRevised::SPATIAL_MEMORY>(seeds, policy).performPixelUpdates();
+    }
+}
+
+void SEEDSRevised::performPixelUpdate(int i, int j) {
+    dispatchPixelUpdate(this, HistogramPixelPolicy(this), i, j);
+}
+
+int SEEDSRevised::performPixelUpdates() {
+    return dispatchPixelUpdates(this, HistogramPixelPolicy(this));
+}
+
+
+void SEEDSRevised::iterate(int iterations) {
+    this->iterationsPerLevel.assign(this->numberOfLevels, 0);
+    this->movesPerLevel.assign(this->numberOfLevels, 0);
+    
+    while (this->currentLevel > 0) {
+        this->iterateLevel(iterations);
+        this->goDownOneLevel();
+    }
+    
+    this->iterateLevel(2*iterations);
+}
+
+bool SEEDSRevised::iterateWithBudget(int iterations, double seconds) {
+    assert(seconds >= 0);
+    
+    this->deadline = cv::getTickCount() + (int64) (seconds*cv::getTickFrequency());
+    this->deadlineExceeded = false;
+    
+    // Once the deadline is exceeded, the remaining levels only go down.
+    this->iterate(iterations);
+    
+    this->deadline = 0;
+    return !this->deadlineExceeded;
+}
+
+bool SEEDSRevised::checkDeadline() {
+    if (this->deadline > 0 && cv::getTickCount() >= this->deadline) {
+        this->deadlineExceeded = true;
+    }
+    
+    return this->deadlineExceeded;
+}
+
+void SEEDSRevised::iterateLevel(int iterations) {
+    
+    int cells = this->currentBlockHeightNumber*this->currentBlockWidthNumber;
+    
+    if (this->checkDeadline()) {
+        return;
+    }
+    
+    this->reinitializeSpatialMemory();
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        int moves = 0;
+        
+        if (iteration > 0 && this->checkDeadline()) {
+            break;
+        }
+        
+        if (this->currentLevel > 0) {
+            moves = this->performBlockUpdates();
+        }
+        else {
+            moves = this->performPixelUpdates();
+        }
+        
+        ++this->iterationsPerLevel[this->currentLevel];
+        this->movesPerLevel[this->currentLevel] += moves;
+        
+        // Without any move, further iterations will not move anything either.
+        if (moves <= this->minimumChange*cells) {
+            break;
+        }
+    }
 }
 
 void SEEDSRevised::reinitializeSpatialMemory() {
-    for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
-        for (int j = 0; j < this->currentBlockWidthNumber; ++j) {
-            this->spatialMemory[i][j] = true;
+    this->spatialMemory.setAll(this->currentBlockHeightNumber, this->currentBlockWidthNumber);
+    
+    if (this->currentLevel == 0) {
+        for (int i = 0; i < this->height; ++i) {
+            for (int j = 0; j < this->width; ++j) {
+                this->updateBoundary(i, j);
+            }
         }
     }
 }
@@ -1004,23 +2377,54 @@ int SEEDSRevised::getLevel() const {
     return this->currentLevel;
 }
 
-int** SEEDSRevised::getLabels() const {
+int SEEDSRevised::getColorSpace() const {
+    return this->colorSpace;
+}
+
+int SEEDSRevised::getMaximumNumberOfBins(int channels) {
+    assert(channels == 1 || channels == 3);
+    
+    int maximumNumberOfBins = (int) floor(pow((double) SEEDSRevised::MAXIMUM_HISTOGRAM_SIZE, 1./channels) + 1e-6);
+    while (pow((double) maximumNumberOfBins, channels) > SEEDSRevised::MAXIMUM_HISTOGRAM_SIZE) {
+        --maximumNumberOfBins;
+    }
+    
+    return maximumNumberOfBins;
+}
+
+int SEEDSRevised::getNumberOfChannels() const {
+    return this->image->channels();
+}
+
+int SEEDSRevised::getSpatialMemoryMode() const {
+    return this->spatialMemoryMode;
+}
+
+cv::Mat_<int> SEEDSRevised::getLabels() const {
+    assert(this->initializedLabels);
+    
+    return cv::Mat_<int>(this->height, this->width, this->currentLabels, this->stride*sizeof(int));
+}
+
+int** SEEDSRevised::getLabelArray() const {
     assert(this->initializedLabels);
     
-    return this->currentLabels;
+    return this->labelRows;
 }
 
 int SEEDSRevised::getNumberOfSuperpixels() const {
     return this->getBlockHeightNumber(this->numberOfLevels)*this->getBlockWidthNumber(this->numberOfLevels);
 }
 
-SEEDSRevisedMeanPixels::SEEDSRevisedMeanPixels(const cv::Mat& image, int numberOfLevels, int minimumBlockWidth, int minimumBlockHeight, int numberOfBins, int neighborhoodSize, float minimumConfidence, float spatialWeight, int colorSpace) : SEEDSRevised(image, numberOfBins, numberOfLevels, minimumBlockWidth, minimumBlockHeight, neighborhoodSize, minimumConfidence, colorSpace) {
+SEEDSRevisedMeanPixels::SEEDSRevisedMeanPixels(const cv::Mat& image, int numberOfLevels, int minimumBlockWidth, int minimumBlockHeight, int numberOfBins, int neighborhoodSize, float minimumConfidence, float spatialWeight, int colorSpace) : SEEDSRevised(image, numberOfLevels, minimumBlockWidth, minimumBlockHeight, numberOfBins, neighborhoodSize, minimumConfidence, colorSpace) {
     assert(spatialWeight >= 0);
     assert(spatialWeight <= 1);
     
     this->initializedMeans = false;
+    this->meanSums = NULL;
     this->spatialWeight = spatialWeight;
-    this->spatialNormalization = 1;
+    this->colorFactor = 0;
+    this->spatialFactor = 0;
 }
 
 SEEDSRevisedMeanPixels::SEEDSRevisedMeanPixels(const cv::Mat& image, int desiredNumberOfSuperpixels, int numberOfBins, int neighborhoodSize, float minimumConfidence, float spatialWeight, int colorSpace) : SEEDSRevised(image, desiredNumberOfSuperpixels, numberOfBins, neighborhoodSize, minimumConfidence, colorSpace) {
@@ -1028,140 +2432,148 @@ SEEDSRevisedMeanPixels::SEEDSRevisedMeanPixels(const cv::Mat& image, int desired
     assert(spatialWeight <= 1);
     
     this->initializedMeans = false;
+    this->meanSums = NULL;
     this->spatialWeight = spatialWeight;
-    this->spatialNormalization = 1;
+    this->colorFactor = 0;
+    this->spatialFactor = 0;
 }
 
 SEEDSRevisedMeanPixels::~SEEDSRevisedMeanPixels() {
+    this->releaseMeans();
+}
+
+void SEEDSRevisedMeanPixels::releaseMeans() {
     
     if (this->initializedMeans == true) {
+        SEEDSRevised::freeAligned(this->meanSums);
         
-        for (int i = 0; i < this->height; ++i) {
-            for (int j = 0; j < this->width; ++j) {
-                delete[] this->means[0][i][j];
-            }
-            
-            delete[] this->means[0][i];
-        }
-        
-        delete[] this->means[0];
-        
-        int superpixelHeightNumber = this->getBlockHeightNumber(this->numberOfLevels);
-        int superpixelWidthNumber = this->getBlockWidthNumber(this->numberOfLevels);
-        
-        for (int i = 0; i < superpixelHeightNumber; ++i) {
-            for (int j = 0; j < superpixelWidthNumber; ++j) {
-                delete[] this->means[1][i][j];
-            }
-
-            delete[] this->means[1][i];
-        }
-        
-        delete[] this->means[1];
-        delete[] this->means;
-        
+        this->meanSums = NULL;
         this->initializedMeans = false;
     }
 }
 
+void SEEDSRevisedMeanPixels::releaseHistograms() {
+    this->releaseMeans();
+    SEEDSRevised::releaseHistograms();
+}
+
 void SEEDSRevisedMeanPixels::iterate(int iterations) {
+    this->iterationsPerLevel.assign(this->numberOfLevels, 0);
+    this->movesPerLevel.assign(this->numberOfLevels, 0);
     
     while (this->currentLevel > 0) {
-        
-        this->reinitializeSpatialMemory();
-        for (int iteration = 0; iteration < iterations; ++iteration) {
-            for (int i = 0; i < this->currentBlockHeightNumber; ++i) {
-                for (int j = 0; j < this->currentBlockWidthNumber; ++j) {
-                    this->performBlockUpdate(i, j);
-                }
-            }
-        }
-        
+        this->iterateLevel(iterations);
         this->goDownOneLevel();
     }
     
     this->initializeMeans();
-    this->reinitializeSpatialMemory();
-    for (int iteration = 0; iteration < 2*iterations; ++iteration) {
-        for (int i = 0; i < this->height; ++i) {
-            for (int j = 0; j < this->width; ++j) {
-                this->performPixelUpdate(i, j);
-            }
-        }
-    }
+    this->iterateLevel(2*iterations);
+}
+
+void SEEDSRevisedMeanPixels::performPixelUpdate(int i, int j) {
+    dispatchPixelUpdate(this, MeanPixelPolicy(this), i, j);
+}
+
+int SEEDSRevisedMeanPixels::performPixelUpdates() {
+    return dispatchPixelUpdates(this, MeanPixelPolicy(this));
 }
 
 void SEEDSRevisedMeanPixels::initializeMeans() {
+    this->validPixelCache = false;
     this->meanDimensions = this->histogramDimensions + 2;
     
-    this->means = new float***[2];
-    this->means[0] = new float**[this->height];
-    this->means[1] = new float**[this->superpixelHeightNumber];
-    
-    for (int i = 0; i < this->superpixelHeightNumber; ++i) {
-        this->means[1][i] = new float*[this->superpixelWidthNumber];
+    // The means are reused when initializing again, see releaseHistograms.
+    if (this->initializedMeans == false) {
+        int alignment = SEEDSRevised::ALIGNMENT/sizeof(float);
+        int numberOfSuperpixels = this->superpixelHeightNumber*this->superpixelWidthNumber;
         
-        for (int j = 0; j < this->superpixelWidthNumber; ++j) {
-            this->means[1][i][j] = new float[this->meanDimensions];
-            
-            for (int k = 0; k < this->meanDimensions; ++k) {
-                this->means[1][i][j][k] = 0;
-            }
-        }
+        this->meanStride = ((numberOfSuperpixels + alignment - 1)/alignment)*alignment;
+        this->meanSums = SEEDSRevised::allocateAligned<float>(2*this->meanDimensions*this->meanStride);
     }
     
+    std::fill(this->meanSums, this->meanSums + 2*this->meanDimensions*this->meanStride, 0.f);
+    
+    float* xSums = this->getMeanSums(this->meanDimensions - 2);
+    float* ySums = this->getMeanSums(this->meanDimensions - 1);
+    
     for (int i = 0; i < this->height; ++i) {
-        this->means[0][i] = new float*[this->width];
+        const unsigned char* row = this->image->ptr(i);
+        const int* labels = this->currentLabels + i*this->stride;
         
         for (int j = 0; j < this->width; ++j) {
-            this->means[0][i][j] = new float[this->meanDimensions];
+            int label = labels[j];
             
-            if (this->histogramDimensions == 1) {
-                this->means[0][i][j][0] = this->image->at<unsigned char>(i, j);
+            for (int k = 0; k < this->histogramDimensions; ++k) {
+                this->getMeanSums(k)[label] += row[j*this->histogramDimensions + k];
             }
-            else if (this->histogramDimensions == 3) {
-                this->means[0][i][j][0] = this->image->at<cv::Vec3b>(i, j)[0];
-                this->means[0][i][j][1] = this->image->at<cv::Vec3b>(i, j)[1];
-                this->means[0][i][j][2] = this->image->at<cv::Vec3b>(i, j)[2];
-            }
-            
-            this->means[0][i][j][this->meanDimensions - 2] = j;
-            this->means[0][i][j][this->meanDimensions - 1] = i;
             
-            int iSuperpixel = this->getSuperpixelIFromLabel(this->currentLabels[i][j]);
-            int jSuperpixel = this->getSuperpixelJFromLabel(this->currentLabels[i][j]);
-            
-            for (int k = 0; k < this->meanDimensions; ++k) {
-                this->means[1][iSuperpixel][jSuperpixel][k] += this->means[0][i][j][k];
-            }
+            xSums[label] += j;
+            ySums[label] += i;
         }
     }
     
-    this->colorNormalization = 255.0f*255.0f*this->histogramDimensions;
-    this->spatialNormalization = this->height*this->height + this->width*this->width;
+    this->computeScoreFactors();
     this->initializedMeans = true;
     
     #ifdef DEBUG
         for (int i = 0; i < superpixelHeightNumber; ++i) {
             for (int j = 0; j < superpixelWidthNumber; ++j) {
+                int label = i*this->superpixelWidthNumber + j;
+                
                 for (int k = 0; k < this->histogramDimensions; ++k) {
-                    float mean = this->means[1][i][j][k]/this->pixels[this->numberOfLevels - 1][i][j];
+                    float mean = this->getMeanSums(k)[label]/this->getPixels(this->numberOfLevels, i, j);
                     assert(mean <= 255);
                 }
                 
-                float mean = this->means[1][i][j][this->meanDimensions - 2]/this->pixels[this->numberOfLevels - 1][i][j];
+                float mean = xSums[label]/this->getPixels(this->numberOfLevels, i, j);
                 assert(mean <= this->width);
                 
-                mean = this->means[1][i][j][this->meanDimensions - 1]/this->pixels[this->numberOfLevels - 1][i][j];
+                mean = ySums[label]/this->getPixels(this->numberOfLevels, i, j);
                 assert(mean <= this->height);
             }
         }
     #endif
 }
 
+void SEEDSRevisedMeanPixels::getMeanColor(int label, float* color) const {
+    assert(this->initializedMeans);
+    
+    int iSuperpixel = this->getSuperpixelIFromLabel(label);
+    int jSuperpixel = this->getSuperpixelJFromLabel(label);
+    int pixels = this->getPixels(this->numberOfLevels, iSuperpixel, jSuperpixel);
+    
+    for (int k = 0; k < this->histogramDimensions; ++k) {
+        color[k] = 0;
+        
+        if (pixels > 0) {
+            color[k] = this->getMeanSums(k)[label]/pixels;
+        }
+    }
+}
+
 void SEEDSRevisedMeanPixels::setSpatialWeight(float spatialWeight) {
     assert(spatialWeight >= 0);
     assert(spatialWeight <= 1);
     
     this->spatialWeight = spatialWeight;
+    
+    // Otherwise computed by initializeMeans.
+    if (this->initializedMeans == true) {
+        this->computeScoreFactors();
+    }
+}
+
+void SEEDSRevisedMeanPixels::computeScoreFactors() {
+    float colorNormalization = 255.0f*255.0f*this->histogramDimensions;
+    float spatialNormalization = this->height*this->height + this->width*this->width;
+    
+    // Without spatial term, the color distance is used unweighted.
+    if (this->spatialWeight > 0) {
+        this->colorFactor = (1 - this->spatialWeight)/colorNormalization;
+        this->spatialFactor = this->spatialWeight/spatialNormalization;
+    }
+    else {
+        this->colorFactor = 1.f/colorNormalization;
+        this->spatialFactor = 0;
+    }
 }
@@ -61,8 +61,12 @@
  * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include "HistogramIntersection.h"
+#include "SpatialMemory.h"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <assert.h>
 
 #ifndef SEEDS_REVISED_H
@@ -80,6 +84,7 @@
     #define SEEDS_REVISED_OPENCV_BGR2HSV cv::COLOR_BGR2HSV
     #define SEEDS_REVISED_OPENCV_BGR2Lab cv::COLOR_BGR2Lab
     #define SEEDS_REVISED_OPENCV_BGR2Luv cv::COLOR_BGR2Luv
+    #define SEEDS_REVISED_OPENCV_Lab2BGR cv::COLOR_Lab2BGR
 #else
     #define SEEDS_REVISED_OPENCV_BGR2Lab CV_BGR2Lab
     #define SEEDS_REVISED_OPENCV_BGR2YCrCb CV_BGR2YCrCb
@@ -89,39 +94,30 @@
     #define SEEDS_REVISED_OPENCV_BGR2HSV CV_BGR2HSV
     #define SEEDS_REVISED_OPENCV_BGR2Lab CV_BGR2Lab
     #define SEEDS_REVISED_OPENCV_BGR2Luv CV_BGR2Luv
+    #define SEEDS_REVISED_OPENCV_Lab2BGR CV_Lab2BGR
 #endif
 
 /**
- * Can be used when in development mode. The algorithm will throw errors whenever
- * an inconsistent state is detected.
+ * DEBUG can be defined when in development mode, e.g. using the SEEDS_REVISED_DEBUG
+ * option of CMake. The algorithm will throw errors whenever an inconsistent state
+ * is detected. DEBUG needs to be defined consistently for the library and all code
+ * including this header.
  * 
  * However, this will slow down the algorithm!
- */
-// #define DEBUG
-
-/**
- * Set this flag when aiming to use uniform binning for color histograms.
- * 
- * The results presented in [2] are based on non-uniform binning.
  * 
- * [2] D. Stutz, A. Hermans, B. Leibe.
- *     Superpixel Segmentation using Depth Information.
- *     Bachelor thesis, RWTH Aachen University, Aachen, Germany, 2014.
+ * Uniform binning and the spatial memory are chosen at runtime instead, see
+ * setUniformBinning and setSpatialMemoryMode.
  */
-// #define UNIFORM
 
 /**
- * For pixel and block updates, a memory can be used to record which pixels or blocks
- * have been changed and which pixels and blocks need to be checked again.
- * This will speed up the runtime as only few blocks and pixel updates are necessary.
+ * Pixel updates are implemented by SEEDSEngine for a given pixel policy deciding
+ * how pixels are scored, see HistogramPixelPolicy and MeanPixelPolicy below.
+ * The policy is resolved at compile time such that scoring a pixel can be inlined
+ * into the sweeps over all pixels.
  */
-#define MEMORY
-
-/**
- * If using MEMORY, this flag will add an additional heuristic speeding up the
- * algorithm but slightly decreasing the quality of the generated superpixel segmentation.
- */
-// #define HEURISTIC_MEMORY
+template <class PixelPolicy, int SpatialMemoryMode> class SEEDSEngine;
+class HistogramPixelPolicy;
+class MeanPixelPolicy;
 
 /**
  * The class SEEDS represents an implementation of SEEDS as described in [1]:
@@ -137,7 +133,9 @@ class SEEDSRevised {
 public:
     
     /**
-     * Color spaces that may be used (default is BGR).
+     * Color spaces that may be used (default is BGR). Color images are expected
+     * in BGR and converted once to the given color space; for BGR and LAB the
+     * algorithm works on Lab.
      */
     static const int BGR = 0;
     static const int LAB = 1;
@@ -146,6 +144,33 @@ public:
     static const int XYZ = 4;
     static const int YCRCB = 5;
     
+    /**
+     * Spatial memory modes (default is SPATIAL_MEMORY), see setSpatialMemoryMode.
+     */
+    static const int NO_SPATIAL_MEMORY = 0;
+    static const int SPATIAL_MEMORY = 1;
+    static const int HEURISTIC_SPATIAL_MEMORY = 2;
+    
+    /**
+     * Alignment in bytes used for histograms and other large arrays.
+     */
+    static const int ALIGNMENT = 64;
+    
+    /**
+     * Maximum number of bins in total; the bin of each pixel and the bins of
+     * sparse histograms are stored using 16 bits.
+     */
+    static const int MAXIMUM_HISTOGRAM_SIZE = 65536;
+    
+    /**
+     * Get the maximum number of bins per channel for the given number of
+     * channels, i.e. 65536 for grayscale and 40 for color images.
+     * 
+     * @param int channels
+     * @return
+     */
+    static int getMaximumNumberOfBins(int channels);
+    
     /**
      * Constructor, instantiates a new SEEDSRevised object with the given parameters.
      * 
@@ -216,6 +241,20 @@ public:
      */
     virtual ~SEEDSRevised();
 
+    /**
+     * Derive number of levels and minimum block size from the desired number
+     * of superpixels, used by the ONE PARAMETER constructor
+     * and by SEEDSRevisedTiled.
+     * 
+     * @param int width
+     * @param int height
+     * @param int desiredNumberOfSuperpixels
+     * @param int numberOfLevels
+     * @param int minimumBlockWidth
+     * @param int minimumBlockHeight
+     */
+    static void computeBlockSize(int width, int height, int desiredNumberOfSuperpixels, int &numberOfLevels, int &minimumBlockWidth, int &minimumBlockHeight);
+    
     /**
      * Get the number of superpixels which are computed according to the
      * number of levels and minimum block size used.
@@ -235,17 +274,51 @@ public:
      * @return 
      */
     int getLevel() const;
+    
+    /**
+     * Get the color space used, see constants at the beginning of the class.
+     * 
+     * @return
+     */
+    int getColorSpace() const;
+    
+    /**
+     * Get the number of channels of the image being oversegmented, 1 or 3.
+     * 
+     * @return
+     */
+    int getNumberOfChannels() const;
+    
+    /**
+     * Get the spatial memory mode used, see setSpatialMemoryMode.
+     * 
+     * @return
+     */
+    int getSpatialMemoryMode() const;
 
     /**
-     * Get the computed labels as two-dimensional array.
+     * Get the computed labels as matrix of the same size as the image.
+     * 
+     * The matrix references the internal labels without copying, it is only
+     * valid as long as this object exists and will change with further iterations.
      * 
      * If used within the iteration of the algorithm (before the bottom level
-     * is reached through goDownOneLevel), the array will not have the same
-     * size as the image and correspond to block labels at the current level.
+     * is reached through goDownOneLevel), only the upper left part of the matrix
+     * is used and corresponds to block labels at the current level.
+     * 
+     * @return
+     */
+    cv::Mat_<int> getLabels() const;
+
+    /**
+     * Get the computed labels as two-dimensional array, the rows point into
+     * the labels returned by getLabels.
+     * 
+     * Provided for compatibility with the helpers in Tools.h.
      * 
      * @return
      */
-    int** getLabels() const;
+    int** getLabelArray() const;
 
     /**
      * Set the number of levels to use. The number of levels influences the 
@@ -278,11 +351,61 @@ public:
      * Set the number of bins used for the histograms.
      * 
      * If using three color channels, the actual number of bins will be the
-     * number of bins to the power of three.
+     * number of bins to the power of three. The bin of each pixel is stored
+     * using 16 bits, so there may be at most 65536 bins in total, i.e. at most
+     * 40 bins per channel for color images, see getMaximumNumberOfBins; larger
+     * numbers of bins raise a cv::Exception.
      * 
      * @param int numberOfBins
      */
     void setNumberOfBins(int numberOfBins);
+    
+    /**
+     * Set whether block histograms may be stored sparsely. If set, the histograms
+     * of all levels whose blocks have at most half as many pixels as there are bins
+     * are stored as lists of (bin, count) pairs sorted by bin, see getSparseHistogram;
+     * the superpixel histograms are always dense.
+     * 
+     * Block updates at these levels then only visit the non-empty bins of the
+     * block, which pays off for large numbers of bins. The scores are summed in
+     * a different order, so results may differ slightly from dense histograms.
+     * 
+     * @param bool sparseHistograms
+     */
+    void setSparseHistograms(bool sparseHistograms);
+    
+    /**
+     * Set whether the color channels are binned uniformly. Otherwise, which is
+     * the default, the bins of each channel are chosen such that they hold
+     * roughly the same number of pixels. Takes effect on the next initialization.
+     * 
+     * The results presented in [2] are based on non-uniform binning.
+     * 
+     * [2] D. Stutz, A. Hermans, B. Leibe.
+     *     Superpixel Segmentation using Depth Information.
+     *     Bachelor thesis, RWTH Aachen University, Aachen, Germany, 2014.
+     * 
+     * @param bool uniformBinning
+     */
+    void setUniformBinning(bool uniformBinning);
+    
+    /**
+     * Set the spatial memory mode used by block and pixel updates:
+     * 
+     * * NO_SPATIAL_MEMORY: all blocks and boundary pixels are checked in each iteration;
+     * * SPATIAL_MEMORY: only blocks and pixels which have been moved and their
+     *   neighbors are checked again, which will speed up the runtime as only few
+     *   block and pixel updates are necessary;
+     * * HEURISTIC_SPATIAL_MEMORY: only neighbors with a different label are
+     *   checked again, speeding up the algorithm but slightly decreasing the
+     *   quality of the generated superpixel segmentation.
+     * 
+     * The updates are compiled for each mode, so the mode does not cost anything
+     * within the sweeps.
+     * 
+     * @param int spatialMemoryMode
+     */
+    void setSpatialMemoryMode(int spatialMemoryMode);
 
     /**
      * Set the neighborhood size. This defines the smoothing term.
@@ -294,13 +417,122 @@ public:
      */
     void setNeighborhoodSize(int neighborhoodSize);
 
+    /**
+     * Set the number of threads to use. With more than one thread, block updates
+     * are distributed using OpenCV's parallel_for_ (the number of threads is
+     * used as number of stripes, the actual threads are provided by OpenCV,
+     * see cv::setNumThreads).
+     * 
+     * Parallel block updates visit the blocks in a different order than the
+     * sequential ones; the result does not depend on the number of threads
+     * as long as it is greater than one. Parallel pixel updates work on horizontal
+     * strips and the result depends on the number of threads.
+     * 
+     * @param int numberOfThreads
+     */
+    void setNumberOfThreads(int numberOfThreads);
+    
+    /**
+     * Set the minimum change needed to continue iterating at a level: once an
+     * iteration moves at most minimumChange times the number of blocks (or pixels)
+     * at the current level, the remaining iterations at this level are skipped.
+     * The number of iterations passed to iterate is used as cap per level.
+     * 
+     * With the default of 0, a level is only left early if an iteration did not
+     * move anything, in which case further iterations would not either; the result
+     * is therefore the same as without early termination.
+     * 
+     * @param float minimumChange in [0,1]
+     */
+    void setMinimumChange(float minimumChange);
+    
+    /**
+     * Get the number of iterations actually run at each level by the last call
+     * of iterate, index 0 is the pixel level.
+     * 
+     * @return
+     */
+    const std::vector<int>& getIterationsPerLevel() const;
+    
+    /**
+     * Get the number of blocks or pixels moved at each level by the last call
+     * of iterate, index 0 is the pixel level.
+     * 
+     * @return
+     */
+    const std::vector<int>& getMovesPerLevel() const;
+
     /**
      * Initialize the algorithm on the given image. After initialization,
      * iterations can be run using the iterate method.
      * 
-     * For a different image, initialization needs to be done again.
+     * For a different image, initialization needs to be done again, see reset.
      */
     virtual void initialize();
+    
+    /**
+     * Replace the image to be oversegmented, all parameters are kept. Afterwards,
+     * the algorithm needs to be initialized again:
+     * 
+     *  seeds.reset(image)
+     *  seeds.initialize()
+     *  seeds.iterate(iterations)
+     * 
+     * Labels, histograms and all other arrays are reused as long as the image size,
+     * the number of channels, the number of levels and bins and the minimum block
+     * size do not change; otherwise they are allocated again by initialize.
+     * 
+     * If the object was constructed using the desired number of superpixels, the
+     * number of levels and the minimum block size are derived again for images
+     * of different size.
+     * 
+     * @param cv::Mat image image to be oversegmented
+     */
+    void reset(const cv::Mat &image);
+    
+    /**
+     * Replace the image to be oversegmented by an image owned by the caller,
+     * which is used without copying or converting it, e.g. a frame in a ring
+     * buffer. The image therefore needs 8 bit channels and needs to be in the
+     * color space the algorithm works on, i.e. Lab for color images when using
+     * BGR (the default) or LAB.
+     * 
+     * The buffer is only read, but needs to stay valid and unchanged until the
+     * next reset (including the mean colors of SEEDSRevisedMeanPixels). Otherwise,
+     * this is the same as reset above.
+     * 
+     * @param const unsigned char* data first pixel of the image
+     * @param int rows
+     * @param int cols
+     * @param size_t step distance between two rows in bytes
+     * @param int channels 1 or 3
+     */
+    void reset(const unsigned char* data, int rows, int cols, size_t step, int channels);
+    
+    /**
+     * Initialize the algorithm on the next frame of a video using the segmentation
+     * of the previous frame, instead of initialize:
+     * 
+     *  seeds.reset(frame)
+     *  seeds.initializeFromPreviousFrame()
+     *  seeds.iterate(iterations)
+     * 
+     * The labels of the previous frame are kept and only the histogram bins of the
+     * pixels and the superpixel histograms are computed again on the new frame,
+     * such that iterate only runs the pixel updates. The new frame is binned using
+     * the bin boundaries of the previous frame, which are only adapted to the
+     * image again on a scene cut or on initialize.
+     * 
+     * The previous frame is considered a scene cut if the superpixel histograms of
+     * both frames (using the labels of the previous frame) overlap in less than
+     * minimumSimilarity of all pixels; in this case, or if the previous frame has
+     * not been segmented completely or differs in size, the algorithm falls back to
+     * initialize and iterate runs the full hierarchy again.
+     * 
+     * @param float minimumSimilarity in [0,1], 0 never falls back
+     * @return bool whether the previous frame has been used
+     */
+    bool initializeFromPreviousFrame(float minimumSimilarity = 0.5);
 
     /**
      * Get block width at the given level.
@@ -334,6 +566,17 @@ public:
      */
     int getBlockHeightNumber(int level) const;
 
+    /**
+     * Get the number of pixels covered by block (i, j) at the given level; the
+     * blocks in the last row and column extend to the border of the image.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
+     * @return 
+     */
+    int getBlockArea(int level, int i, int j) const;
+
     /**
      * Go down one level. Here, the labels are adapted to the new number
      * of blocks.
@@ -342,19 +585,52 @@ public:
 
     /**
      * Run iterations. The algorithm will do iterations iterations at all block
-     * levels and 2*iterations iterations at the pixel level.
+     * levels and 2*iterations iterations at the pixel level, less if a level
+     * converges earlier, see setMinimumChange.
      * 
      * @param int iterations
      */
     virtual void iterate(int iterations);
+    
+    /**
+     * Run iterations as iterate, but within the given time budget. Before each
+     * iteration, the elapsed time is checked; once the budget is exceeded, the
+     * remaining iterations are skipped and the block labels are projected down
+     * to the pixel level using goDownOneLevel, such that afterwards there is
+     * always a label for each pixel.
+     * 
+     * @param int iterations
+     * @param double seconds time budget in seconds
+     * @return bool whether all iterations have been run within the budget
+     */
+    bool iterateWithBudget(int iterations, double seconds);
 
     /**
      * Perform a block update for the given block.
      * 
      * @param int i
      * @param int j
+     * @return bool whether the block has been moved
+     */
+    bool performBlockUpdate(int i, int j);
+
+    /**
+     * Perform one iteration of block updates at the current level, that is
+     * a block update for all blocks. Uses parallel block updates if more than
+     * one thread is set, see setNumberOfThreads.
+     * 
+     * @return int number of blocks moved
+     */
+    int performBlockUpdates();
+
+    /**
+     * Perform one iteration of pixel updates, that is a pixel update for all
+     * pixels. Uses parallel pixel updates if more than one thread is set, see
+     * setNumberOfThreads.
+     * 
+     * @return int number of pixels moved
      */
-    virtual void performBlockUpdate(int i, int j);
+    virtual int performPixelUpdates();
 
     /**
      * Perform a pixel update for the given pixel.
@@ -366,85 +642,277 @@ public:
 
     /**
      * Spatial memory needs to be "refreshed" before beginning iterations
-     * at a new level.
+     * at a new level. At the pixel level, also the boundary pixels are determined.
      */
     virtual void reinitializeSpatialMemory();
 
 protected:
+    
+    template <class PixelPolicy, int SpatialMemoryMode> friend class SEEDSEngine;
+    friend class HistogramPixelPolicy;
+
+    /**
+     * A block or pixel update as proposed by proposeBlockUpdate or 
+     * SEEDSEngine::proposePixelUpdate, the arguments needed for updateBlock or
+     * SEEDSEngine::updatePixel.
+     */
+    struct Update {
+        int iFrom;
+        int jFrom;
+        int iTo;
+        int jTo;
+        int iSuperpixelFrom;
+        int jSuperpixelFrom;
+        int iSuperpixelTo;
+        int jSuperpixelTo;
+        int iPlusOne;
+        int iMinusOne;
+        int jPlusOne;
+        int jMinusOne;
+        bool valid;
+    };
+
+    /**
+     * Proposes block updates for a set of independent blocks in parallel,
+     * see performBlockUpdates.
+     */
+    template <int SpatialMemoryMode> class BlockUpdateInvoker;
+    
+    /**
+     * Computes the histogram bins for a range of rows, see computeHistogramBins.
+     */
+    class HistogramBinInvoker;
+    
+    /**
+     * Initializes the histograms of a range of block rows of one level,
+     * see initializeHistogramRow.
+     */
+    class HistogramLevelInvoker;
+    
+    /**
+     * The sparse histograms of one level: the entries of block (i, j) start at
+     * offsets[i*levelWidthNumbers[level - 1] + j] within bins and counts.
+     */
+    struct SparseLevel {
+        unsigned short* bins;
+        unsigned short* counts;
+        int* offsets;
+        int* lengths;
+    };
+
+    /**
+     * Number of pixels of each superpixel within the (2*neighborhoodSize + 1)
+     * x (2*neighborhoodSize + 1) window around pixel (i, j), used for the smoothing
+     * prior of pixel updates. The window is shared by the four directions of
+     * a pixel and moved along the rows of a sweep, see SEEDSEngine.
+     */
+    struct NeighborhoodCounts {
+        /**
+         * Number of pixels within the window indexed by label.
+         */
+        std::vector<int> counts;
+        /**
+         * Labels counted since the window was last rebuilt, used to reset counts.
+         */
+        std::vector<int> labels;
+        /**
+         * Center of the window, -1 if there is no window.
+         */
+        int i;
+        int j;
+    };
+
+    /**
+     * A horizontal strip of the image used for parallel pixel updates, see
+     * performPixelUpdates.
+     */
+    struct PixelStrip {
+        /**
+         * First row of the strip.
+         */
+        int iStart;
+        /**
+         * Row after the last row of the strip.
+         */
+        int iEnd;
+        /**
+         * Pixel updates applied to the labels but not yet to the superpixel
+         * histograms.
+         */
+        std::vector<Update> updates;
+        /**
+         * Change of the number of pixels of each superpixel caused by updates.
+         */
+        std::vector<int> pixelDeltas;
+        /**
+         * Smoothing prior counts of the strip.
+         */
+        NeighborhoodCounts neighborhood;
+    };
 
     /**
      * Proxy for multiple constructors.
      */
     void construct(const cv::Mat &image, int numberOfBins, int numberOfLevels, int minimumBlockWidth, int minimumBlockHeight, int neighborhoodSize, float minimumConfidence, int colorSpace);
     
+    /**
+     * Convert the given image to 8 bit channels and copy it to image, also
+     * sets height, width and stride. Color images are converted from BGR to the
+     * used color space, which is the only color conversion of an image.
+     * 
+     * @param cv::Mat image
+     */
+    void copyImage(const cv::Mat &image);
+    
+    /**
+     * Set height, width and stride according to image.
+     */
+    void updateImageSize();
+    
+    /**
+     * Release labels and histograms if they do not fit an image of the given size
+     * and number of channels, see reset.
+     * 
+     * @param int rows
+     * @param int cols
+     * @param int channels
+     * @return whether the size of the image changed
+     */
+    bool releaseForImage(int rows, int cols, int channels);
+    
+    /**
+     * Free labels and spatial memory.
+     */
+    void releaseLabels();
+    
+    /**
+     * Free histograms, pixel counts and histogram bins, needs to be called before
+     * changing the configuration the histograms depend on.
+     */
+    virtual void releaseHistograms();
+    
+    /**
+     * Get the OpenCV code converting BGR images to the used color space, see
+     * constants at the beginning of the class; for BGR, the algorithm works on Lab.
+     * 
+     * @return
+     */
+    int getColorConversion() const;
+    
+    /**
+     * Run at most the given number of iterations at the current level, block updates
+     * or pixel updates depending on the level, see setMinimumChange.
+     * 
+     * @param int iterations
+     */
+    void iterateLevel(int iterations);
+    
+    /**
+     * Check whether the deadline set by iterateWithBudget has been exceeded.
+     * 
+     * @return
+     */
+    bool checkDeadline();
+    
     /**
      * Initialize labels. In the end, each pixel will be assigned a label. During block updates,
      * labels will be kept per block.
      */
     void initializeLabels();
+    
+    /**
+     * Compute the superpixel histograms and pixel counts, that is the highest level,
+     * from the current pixel labels; used to start from the labels of the previous frame.
+     */
+    void computeSuperpixelHistograms();
 
     /**
-     * Histograms are built level-wise beginning with the first level.
+     * Allocate the histograms if needed, compute the histogram bins of the
+     * pixels and build the histograms, see buildHistograms.
      */
     void initializeHistograms();
-
+    
+    /**
+     * Histograms are built level-wise beginning with the first level, from the
+     * current histogram bins.
+     */
+    void buildHistograms();
+    
     /**
-     * Compute the histogram intersection between the current block histogram
-     * and the given superpixel histogram.
+     * Compute the per-channel lookup tables of the histogram bins, binLookup,
+     * from the image: uniform bins or bins holding roughly the same number of
+     * pixels, see setUniformBinning.
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iSuperpixelFrom
-     * @param int jSuperpixelFrom
-     * @return 
+     * @return whether the lookup tables changed
      */
-    virtual inline float scoreCurrentBlockSegmentation(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom) {
-        float currentScore = 0.;
-        float difference = 0.;
-
-        float superpixelMinusBlockPixels = this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->pixels[this->currentLevel - 1][iFrom][jFrom];
-        float blockPixels = this->pixels[this->currentLevel - 1][iFrom][jFrom];
-
-        for (int k = 0; k < this->histogramSize; ++k) {
-
-            if (this->histograms[this->currentLevel - 1][iFrom][jFrom][k] > 0 
-                    && this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][k] > this->histograms[this->currentLevel - 1][iFrom][jFrom][k]) {
-
-                difference = this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][k] - this->histograms[this->currentLevel - 1][iFrom][jFrom][k];
-                currentScore += std::min(difference/superpixelMinusBlockPixels, this->histograms[this->currentLevel - 1][iFrom][jFrom][k]/blockPixels);
-            }
-        }
-
-        return currentScore;
-    }
-
+    bool computeBinLookup();
+    
+    /**
+     * Compute the histogram bin of each pixel. The bins of the individual channels
+     * are taken from the lookup tables in binLookup such that each pixel only
+     * needs one lookup per channel; the rows are processed in parallel.
+     */
+    void computeHistogramBins();
+    
     /**
-     * Compute the intersection between the current block histogram and the new 
-     * superpixel histogram.
+     * Initialize the histograms and pixel counts of the given row of blocks at
+     * the given level, from the pixels for level 1 and from the level below
+     * otherwise. Rows of the same level may be initialized in parallel.
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iSuperpixelTo
-     * @param int jSuperpixelTo
-     * @return 
+     * Sparse histograms are counted in binCounts, which needs histogramSize entries
+     * set to zero, while countedBins remembers the bins counted; see storeSparseHistogram.
+     * 
+     * @param int level
+     * @param int i
+     * @param std::vector<int> binCounts
+     * @param std::vector<int> countedBins
      */
-    virtual inline float scoreProposedBlockSegmentation(int iFrom, int jFrom, int iSuperpixelTo, int jSuperpixelTo) {
-        float proposedScore = 0.;
-
-        float superpixelPixels = this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo];
-        float blockPixels = this->pixels[this->currentLevel - 1][iFrom][jFrom];
-
-        for (int k = 0; k < this->histogramSize; ++k) {
-
-            if (this->histograms[this->currentLevel - 1][iFrom][jFrom][k] > 0
-                    && this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][k] > 0) {
-
-                proposedScore += std::min(this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][k]/superpixelPixels, this->histograms[this->currentLevel - 1][iFrom][jFrom][k]/blockPixels);
-            }
-        }
+    void initializeHistogramRow(int level, int i, std::vector<int> &binCounts, std::vector<int> &countedBins);
+    
+    /**
+     * Store the bins counted in binCounts as sparse histogram of block (i, j) at
+     * the given level and set binCounts to zero again.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
+     * @param std::vector<int> binCounts
+     * @param std::vector<int> countedBins
+     */
+    void storeSparseHistogram(int level, int i, int j, std::vector<int> &binCounts, std::vector<int> &countedBins);
 
-        return  proposedScore;
-    }
+    /**
+     * Find the best update for the given block without applying it. Apart from
+     * the spatial memory of the given block, nothing is changed such that blocks
+     * not being neighbors can be considered in parallel.
+     * 
+     * @param int i
+     * @param int j
+     * @param Update update the best update if there is one
+     * @return whether the block should be moved
+     */
+    template <int SpatialMemoryMode>
+    bool proposeBlockUpdate(int i, int j, Update &update);
+    
+    /**
+     * Perform a block update for the given block using the given spatial memory
+     * mode, see performBlockUpdate.
+     * 
+     * @param int i
+     * @param int j
+     * @return bool whether the block has been moved
+     */
+    template <int SpatialMemoryMode>
+    bool performBlockUpdateUsing(int i, int j);
+    
+    /**
+     * Perform one iteration of block updates using the given spatial memory
+     * mode, see performBlockUpdates.
+     * 
+     * @return int number of blocks moved
+     */
+    template <int SpatialMemoryMode>
+    int performBlockUpdatesUsing();
 
     /**
      * Assign the given block to the new label, updating histogram and pixels.
@@ -462,180 +930,309 @@ protected:
      * @param int jPlusOne
      * @param int jMinusOne
      */
-    virtual inline void updateBlock(int iFrom, int jFrom, int iTo, int jTo, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo, int iPlusOne, int iMinusOne, int jPlusOne, int jMinusOne) {
-        this->currentLabels[iFrom][jFrom] = this->currentLabels[iTo][jTo];
+    template <int SpatialMemoryMode>
+    inline void updateBlock(int iFrom, int jFrom, int iTo, int jTo, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo, int iPlusOne, int iMinusOne, int jPlusOne, int jMinusOne) {
+        this->currentLabels[iFrom*this->stride + jFrom] = this->currentLabels[iTo*this->stride + jTo];
 
-        this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] -= this->pixels[this->currentLevel - 1][iFrom][jFrom];
-        this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] += this->pixels[this->currentLevel - 1][iFrom][jFrom];
+        this->getPixels(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom) -= this->getPixels(this->currentLevel, iFrom, jFrom);
+        this->getPixels(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo) += this->getPixels(this->currentLevel, iFrom, jFrom);
 
-        for (int k = 0; k < this->histogramSize; ++k) {
-            this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][k] -= this->histograms[this->currentLevel - 1][iFrom][jFrom][k];
-            this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][k] += this->histograms[this->currentLevel - 1][iFrom][jFrom][k];
+        int* superpixelHistogramFrom = this->getHistogram(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom);
+        int* superpixelHistogramTo = this->getHistogram(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo);
+        
+        if (this->currentLevel <= this->numberOfSparseLevels) {
+            const unsigned short* bins;
+            const unsigned short* counts;
+            int length = this->getSparseHistogram(this->currentLevel, iFrom, jFrom, bins, counts);
+            
+            for (int k = 0; k < length; ++k) {
+                superpixelHistogramFrom[bins[k]] -= counts[k];
+                superpixelHistogramTo[bins[k]] += counts[k];
+            }
+        }
+        else if (this->currentLevel <= this->numberOfNarrowLevels) {
+            SEEDSRevised::moveHistogram(this->getNarrowHistogram(this->currentLevel, iFrom, jFrom), 
+                    superpixelHistogramFrom, superpixelHistogramTo, this->histogramSize);
+        }
+        else {
+            SEEDSRevised::moveHistogram(this->getHistogram(this->currentLevel, iFrom, jFrom), 
+                    superpixelHistogramFrom, superpixelHistogramTo, this->histogramSize);
         }
 
-        #ifdef MEMORY
-            #ifdef HEURISTIC_MEMORY
-                this->spatialMemory[iFrom][jFrom] = true;
-                this->spatialMemory[iPlusOne][jFrom] = this->spatialMemory[iPlusOne][jFrom] || (this->currentLabels[iPlusOne][jFrom] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iMinusOne][jFrom] = this->spatialMemory[iMinusOne][jFrom] || (this->currentLabels[iMinusOne][jFrom] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iFrom][jPlusOne] = this->spatialMemory[iFrom][jPlusOne] || (this->currentLabels[iFrom][jPlusOne] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iFrom][jMinusOne] = this->spatialMemory[iFrom][jMinusOne] || (this->currentLabels[iFrom][jMinusOne] != this->currentLabels[iFrom][jFrom]);
-            #else
-                this->spatialMemory[iFrom][jFrom] = true;
-                this->spatialMemory[iPlusOne][jFrom] = true;
-                this->spatialMemory[iMinusOne][jFrom] = true;
-                this->spatialMemory[iFrom][jPlusOne] = true;
-                this->spatialMemory[iFrom][jMinusOne] = true;
-            #endif
-        #endif
+        this->updateSpatialMemory<SpatialMemoryMode>(iFrom, jFrom, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
 
         #ifdef DEBUG
             int sumFrom = 0;
             int sumTo = 0;
             for (int k = 0; k < this->histogramSize; ++k) {
-                sumFrom += this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][k];
-                sumTo += this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][k];
+                sumFrom += this->getHistogram(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)[k];
+                sumTo += this->getHistogram(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo)[k];
             }
 
-            assert(sumFrom == this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom]);
-            assert(sumTo == this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo]);
+            assert(sumFrom == this->getPixels(this->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom));
+            assert(sumTo == this->getPixels(this->numberOfLevels, iSuperpixelTo, jSuperpixelTo));
         #endif
     }
 
     /**
-     * Compute the probability of the current pixel belonging to the given
-     * superpixel.
+     * Move the given block histogram from one superpixel histogram to another.
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iSuperpixelFrom
-     * @param int jSuperpixelFrom
-     * @return 
+     * @param const T* blockHistogram
+     * @param int* superpixelHistogramFrom
+     * @param int* superpixelHistogramTo
+     * @param int length
      */
-    virtual inline float scoreCurrentPixelSegmentation(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom) {
-        #ifdef DEBUG
-            assert(this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][this->histogramBins[iFrom][jFrom]] <= this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom]);
-        #endif
-
-        return ((float) this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][this->histogramBins[iFrom][jFrom]])/((float) this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom]);
+    template <typename T>
+    static inline void moveHistogram(const T* blockHistogram, int* superpixelHistogramFrom, int* superpixelHistogramTo, int length) {
+        for (int k = 0; k < length; ++k) {
+            superpixelHistogramFrom[k] -= blockHistogram[k];
+            superpixelHistogramTo[k] += blockHistogram[k];
+        }
     }
 
     /**
-     * Compute the probability of the current pixel belonging to the
-     * new superpixel.
+     * After moving the given block or pixel, remember to check it and its
+     * neighbors again. The spatial memory mode is a template parameter such
+     * that the branches below are resolved at compile time.
      * 
      * @param int iFrom
      * @param int jFrom
-     * @param int iSuperpixelTo
-     * @param int jSuperpixelTo
+     * @param int iPlusOne
+     * @param int iMinusOne
+     * @param int jPlusOne
+     * @param int jMinusOne
+     */
+    template <int SpatialMemoryMode>
+    inline void updateSpatialMemory(int iFrom, int jFrom, int iPlusOne, int iMinusOne, int jPlusOne, int jMinusOne) {
+        if (SpatialMemoryMode == NO_SPATIAL_MEMORY) {
+            return;
+        }
+        
+        this->spatialMemory.set(iFrom, jFrom);
+        
+        if (SpatialMemoryMode == HEURISTIC_SPATIAL_MEMORY) {
+            int label = this->currentLabels[iFrom*this->stride + jFrom];
+            
+            if (this->currentLabels[iPlusOne*this->stride + jFrom] != label) {
+                this->spatialMemory.set(iPlusOne, jFrom);
+            }
+            
+            if (this->currentLabels[iMinusOne*this->stride + jFrom] != label) {
+                this->spatialMemory.set(iMinusOne, jFrom);
+            }
+            
+            if (this->currentLabels[iFrom*this->stride + jPlusOne] != label) {
+                this->spatialMemory.set(iFrom, jPlusOne);
+            }
+            
+            if (this->currentLabels[iFrom*this->stride + jMinusOne] != label) {
+                this->spatialMemory.set(iFrom, jMinusOne);
+            }
+        }
+        else {
+            this->spatialMemory.set(iPlusOne, jFrom);
+            this->spatialMemory.set(iMinusOne, jFrom);
+            this->spatialMemory.set(iFrom, jPlusOne);
+            this->spatialMemory.set(iFrom, jMinusOne);
+        }
+    }
+
+    /**
+     * Check whether pixel (i, j) lies on a superpixel boundary, that is one of its
+     * four neighbors (including the padded border) has a different label.
+     * 
+     * @param int i
+     * @param int j
+     */
+    inline void updateBoundary(int i, int j) {
+        const int* labels = this->currentLabels + i*this->stride + j;
+        int label = labels[0];
+        
+        if (labels[this->stride] != label || labels[-this->stride] != label
+                || labels[1] != label || labels[-1] != label) {
+            this->boundary.set(i, j);
+        }
+        else {
+            this->boundary.reset(i, j);
+        }
+    }
+    
+    /**
+     * After moving pixel (i, j), the boundary may only change for the pixel and
+     * its four neighbors.
+     * 
+     * @param int i
+     * @param int j
+     */
+    inline void updateBoundaries(int i, int j) {
+        this->updateBoundary(i, j);
+        
+        if (i > 0) {
+            this->updateBoundary(i - 1, j);
+        }
+        
+        if (i < this->height - 1) {
+            this->updateBoundary(i + 1, j);
+        }
+        
+        if (j > 0) {
+            this->updateBoundary(i, j - 1);
+        }
+        
+        if (j < this->width - 1) {
+            this->updateBoundary(i, j + 1);
+        }
+    }
+
+    /**
+     * Get the histogram of block (i, j) at the given level, the superpixel
+     * histograms are found at level numberOfLevels. The level needs to be
+     * above numberOfNarrowLevels, see getNarrowHistogram.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
      * @return 
      */
-    virtual inline float scoreProposedPixelSegmentation(int iFrom, int jFrom, int iSuperpixelTo, int jSuperpixelTo) {
+    inline int* getHistogram(int level, int i, int j) const {
         #ifdef DEBUG
-            assert(this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][this->histogramBins[iFrom][jFrom]] <= this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo]);
+            assert(level > this->numberOfNarrowLevels && level <= this->numberOfLevels);
+            assert(j >= 0 && j < this->levelWidthNumbers[level - 1]);
         #endif
 
-        return ((float) this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][this->histogramBins[iFrom][jFrom]])/((float) this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo]);
-
+        return this->histograms[level - 1] + (i*this->levelWidthNumbers[level - 1] + j)*this->histogramStride;
     }
-
+    
     /**
-     * Add smoothing prior.
+     * Get the 16 bit histogram of block (i, j) at the given level, which needs
+     * to be above numberOfSparseLevels and at most numberOfNarrowLevels.
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iTo
-     * @param int jTo
-     * @param float currentScore
-     * @param float proposedScore
+     * @param int level
+     * @param int i
+     * @param int j
      * @return 
      */
-    virtual inline float scorePixelUpdate(int iFrom, int jFrom, int iTo, int jTo, float currentScore, float proposedScore) {
+    inline unsigned short* getNarrowHistogram(int level, int i, int j) const {
+        #ifdef DEBUG
+            assert(level > this->numberOfSparseLevels && level <= this->numberOfNarrowLevels);
+            assert(j >= 0 && j < this->levelWidthNumbers[level - 1]);
+        #endif
 
-        if (this->neighborhoodSize > 0) {
+        return this->narrowHistograms[level - 1] + (i*this->levelWidthNumbers[level - 1] + j)*this->histogramStride;
+    }
+    
+    /**
+     * Get the sparse histogram of block (i, j) at the given level, which needs
+     * to be at most numberOfSparseLevels; the bins are sorted.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
+     * @param const unsigned short* bins set to the non-empty bins
+     * @param const unsigned short* counts set to the counts of these bins
+     * @return number of non-empty bins
+     */
+    inline int getSparseHistogram(int level, int i, int j, const unsigned short* &bins, const unsigned short* &counts) const {
+        #ifdef DEBUG
+            assert(level > 0 && level <= this->numberOfSparseLevels);
+            assert(j >= 0 && j < this->levelWidthNumbers[level - 1]);
+        #endif
+        
+        const SparseLevel &sparseLevel = this->sparseLevels[level - 1];
+        int index = i*this->levelWidthNumbers[level - 1] + j;
+        
+        bins = sparseLevel.bins + sparseLevel.offsets[index];
+        counts = sparseLevel.counts + sparseLevel.offsets[index];
+        return sparseLevel.lengths[index];
+    }
 
-            int labelFrom = this->currentLabels[iFrom][jFrom];
-            int labelTo = this->currentLabels[iTo][jTo];
+    /**
+     * Get the number of pixels counted in the histogram of block (i, j) at
+     * the given level, whichever way it is stored; used for debugging.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
+     * @return 
+     */
+    int sumHistogram(int level, int i, int j) const;
 
-            int countFrom = 0;
-            int countTo = 0;
+    /**
+     * Get the number of pixels in block (i, j) at the given level.
+     * 
+     * @param int level
+     * @param int i
+     * @param int j
+     * @return 
+     */
+    inline int& getPixels(int level, int i, int j) const {
+        #ifdef DEBUG
+            assert(level > 0 && level <= this->numberOfLevels);
+            assert(j >= 0 && j < this->levelWidthNumbers[level - 1]);
+        #endif
 
-            int iStart = std::max(0, std::min(iFrom, iTo) - this->neighborhoodSize);
-            int iEnd = std::min(this->currentBlockHeightNumber, std::max(iFrom, iTo) + this->neighborhoodSize + 1);
+        return this->pixels[level - 1][i*this->levelWidthNumbers[level - 1] + j];
+    }
 
-            int jStart = std::max(0, std::min(jFrom, jTo) - this->neighborhoodSize);
-            int jEnd = std::min(this->currentBlockWidthNumber, std::max(jFrom, jTo) + this->neighborhoodSize + 1);
+    /**
+     * Allocate memory for count elements aligned to ALIGNMENT bytes, needs
+     * to be freed using freeAligned.
+     * 
+     * @param size_t count
+     * @return 
+     */
+    template <typename T>
+    static T* allocateAligned(size_t count) {
+        unsigned char* memory = new unsigned char[count*sizeof(T) + ALIGNMENT + sizeof(void*)];
+        unsigned char* aligned = memory + sizeof(void*);
+        aligned += (ALIGNMENT - ((size_t) aligned) % ALIGNMENT) % ALIGNMENT;
 
-            for (int i = iStart; i < iEnd; ++i) {
-                for (int j = jStart; j < jEnd; ++j) {
-                    if (this->currentLabels[i][j] == labelFrom) {
-                        ++countFrom;
-                    }
-                    else if (this->currentLabels[i][j] == labelTo) {
-                        ++countTo;
-                    }
-                }
-            }
+        // Remember the original pointer directly in front of the aligned memory.
+        ((unsigned char**) aligned)[-1] = memory;
+        return (T*) aligned;
+    }
 
-            currentScore *= countFrom;
-            proposedScore *= countTo;
+    /**
+     * Free memory allocated using allocateAligned.
+     * 
+     * @param void* pointer
+     */
+    static void freeAligned(void* pointer) {
+        if (pointer != NULL) {
+            delete[] ((unsigned char**) pointer)[-1];
         }
-
-        return proposedScore - currentScore;
     }
 
     /**
-     * Assign the given pixel to the new superpixel.
+     * Allocate a padded (height + 2) x stride plane with all entries set to the
+     * given value. The returned pointer references the first pixel inside the
+     * padding such that the plane needs to be freed using 
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iTo
-     * @param int jTo
-     * @param int iSuperpixelFrom
-     * @param int jSuperpixelFrom
-     * @param int iSuperpixelTo
-     * @param int jSuperpixelTo
-     * @param int iPlusOne
-     * @param int iMinusOne
-     * @param int jPlusOne
-     * @param int jMinusOne
+     *  freeAligned(plane - stride - 1)
+     * 
+     * @param T value
+     * @return 
      */
-    virtual inline void updatePixel(int iFrom, int jFrom, int iTo, int jTo, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo, int iPlusOne, int iMinusOne, int jPlusOne, int jMinusOne) {
-        this->currentLabels[iFrom][jFrom] = this->currentLabels[iTo][jTo];
-
-        --this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom];
-        ++this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo];
-
-        --this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][this->histogramBins[iFrom][jFrom]];
-        ++this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][this->histogramBins[iFrom][jFrom]];
-
-        #ifdef MEMORY
-            #ifdef HEURISTIC_MEMORY
-                this->spatialMemory[iFrom][jFrom] = true;
-                this->spatialMemory[iPlusOne][jFrom] = this->spatialMemory[iPlusOne][jFrom] || (this->currentLabels[iPlusOne][jFrom] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iMinusOne][jFrom] = this->spatialMemory[iMinusOne][jFrom] || (this->currentLabels[iMinusOne][jFrom] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iFrom][jPlusOne] = this->spatialMemory[iFrom][jPlusOne] || (this->currentLabels[iFrom][jPlusOne] != this->currentLabels[iFrom][jFrom]);
-                this->spatialMemory[iFrom][jMinusOne] = this->spatialMemory[iFrom][jMinusOne] || (this->currentLabels[iFrom][jMinusOne] != this->currentLabels[iFrom][jFrom]);
-            #else
-                this->spatialMemory[iFrom][jFrom] = true;
-                this->spatialMemory[iPlusOne][jFrom] = true;
-                this->spatialMemory[iMinusOne][jFrom] = true;
-                this->spatialMemory[iFrom][jPlusOne] = true;
-                this->spatialMemory[iFrom][jMinusOne] = true;
-            #endif
-        #endif
-
-        #ifdef DEBUG
-            int sumFrom = 0;
-            int sumTo = 0;
-            for (int k = 0; k < this->histogramSize; ++k) {
-                sumFrom += this->histograms[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom][k];
-                sumTo += this->histograms[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo][k];
-            }
+    template <typename T>
+    T* allocatePlane(T value) const {
+        size_t size = (this->height + 2)*this->stride;
+        T* plane = SEEDSRevised::allocateAligned<T>(size);
+        std::fill(plane, plane + size, value);
+        
+        return plane + this->stride + 1;
+    }
 
-            assert(sumFrom == this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom]);
-            assert(sumTo == this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo]);
-        #endif
+    /**
+     * Set all entries of a plane allocated using allocatePlane, including the
+     * padding, to the given value.
+     * 
+     * @param T* plane
+     * @param T value
+     */
+    template <typename T>
+    void fillPlane(T* plane, T value) const {
+        T* begin = plane - this->stride - 1;
+        std::fill(begin, begin + (this->height + 2)*this->stride, value);
     }
 
     /**
@@ -697,29 +1294,16 @@ protected:
         // <----------->
         //   horizontal
 
-        int l11 = this->currentLabels[iMinusOne][jMinusOne];
-        int l12 = this->currentLabels[iMinusOne][jFrom];
-        int l13 = this->currentLabels[iMinusOne][jPlusOne];
-        int l21 = this->currentLabels[iFrom][jMinusOne];
-        int l22 = this->currentLabels[iFrom][jFrom];
-        int l23 = this->currentLabels[iFrom][jPlusOne];
-
-        // To avoid border splits.
-        if (iFrom == 0) {
-            l11 = -1;
-            l12 = -1;
-            l13 = -1;
-        }
-
-        if (jFrom == 0) {
-            l11 = -1;
-            l21 = -1;
-        }
+        // Reading the padded border of -1 labels avoids border splits.
+        const int* above = this->currentLabels + iMinusOne*this->stride;
+        const int* row = this->currentLabels + iFrom*this->stride;
 
-        if (jFrom == this->width - 1) {
-            l13 = -1;
-            l23 = -1;
-        }
+        int l11 = above[jMinusOne];
+        int l12 = above[jFrom];
+        int l13 = above[jPlusOne];
+        int l21 = row[jMinusOne];
+        int l22 = row[jFrom];
+        int l23 = row[jPlusOne];
 
         if (l12 != l22 && l21 == l22 && l23 == l22) {
             return true;
@@ -759,29 +1343,16 @@ protected:
         // <----------->
         //   horizontal
 
-        int l21 = this->currentLabels[iFrom][jMinusOne];
-        int l22 = this->currentLabels[iFrom][jFrom];
-        int l23 = this->currentLabels[iFrom][jPlusOne];
-        int l31 = this->currentLabels[iPlusOne][jMinusOne];
-        int l32 = this->currentLabels[iPlusOne][jFrom];
-        int l33 = this->currentLabels[iPlusOne][jPlusOne];
-
-        // To avoid border splits.
-        if (iFrom == this->height - 1) {
-            l31 = -1;
-            l32 = -1;
-            l33 = -1;
-        }
+        // Reading the padded border of -1 labels avoids border splits.
+        const int* row = this->currentLabels + iFrom*this->stride;
+        const int* below = this->currentLabels + iPlusOne*this->stride;
 
-        if (jFrom == 0) {
-            l21 = -1;
-            l31 = -1;
-        }
-
-        if (jFrom == this->width - 1) {
-            l23 = -1;
-            l33 = -1;
-        }
+        int l21 = row[jMinusOne];
+        int l22 = row[jFrom];
+        int l23 = row[jPlusOne];
+        int l31 = below[jMinusOne];
+        int l32 = below[jFrom];
+        int l33 = below[jPlusOne];
 
         if (l32 != l22 && l21 == l22 && l23 == l22) {
             return true;
@@ -821,29 +1392,17 @@ protected:
         // <----------->
         //   horizontal
 
-        int l11 = this->currentLabels[iMinusOne][jMinusOne];
-        int l12 = this->currentLabels[iMinusOne][jFrom];
-        int l21 = this->currentLabels[iFrom][jMinusOne];
-        int l22 = this->currentLabels[iFrom][jFrom];
-        int l31 = this->currentLabels[iPlusOne][jMinusOne];
-        int l32 = this->currentLabels[iPlusOne][jFrom];
-
-        // To avoid border splits.
-        if (iFrom == 0) {
-            l11 = -1;
-            l12 = -1;
-        }
+        // Reading the padded border of -1 labels avoids border splits.
+        const int* above = this->currentLabels + iMinusOne*this->stride;
+        const int* row = this->currentLabels + iFrom*this->stride;
+        const int* below = this->currentLabels + iPlusOne*this->stride;
 
-        if (iFrom == this->height - 1) {
-            l31 = -1;
-            l32 = -1;
-        }
-
-        if (jFrom == 0) {
-            l11 = -1;
-            l21 = -1;
-            l31 = -1;
-        }
+        int l11 = above[jMinusOne];
+        int l12 = above[jFrom];
+        int l21 = row[jMinusOne];
+        int l22 = row[jFrom];
+        int l31 = below[jMinusOne];
+        int l32 = below[jFrom];
 
         if (l21 != l22 && l12 == l22 && l32 == l22) {
             return true;
@@ -883,29 +1442,17 @@ protected:
         // <----------->
         //   horizontal
 
-        int l12 = this->currentLabels[iMinusOne][jFrom];
-        int l13 = this->currentLabels[iMinusOne][jPlusOne];
-        int l22 = this->currentLabels[iFrom][jFrom];
-        int l23 = this->currentLabels[iFrom][jPlusOne];
-        int l32 = this->currentLabels[iPlusOne][jFrom];
-        int l33 = this->currentLabels[iPlusOne][jPlusOne];
-
-        // To avoid border splits.
-        if (iFrom == 0) {
-            l12 = -1;
-            l13 = -1;
-        }
-
-        if (iFrom == this->height - 1) {
-            l32 = -1;
-            l33 = -1;
-        }
+        // Reading the padded border of -1 labels avoids border splits.
+        const int* above = this->currentLabels + iMinusOne*this->stride;
+        const int* row = this->currentLabels + iFrom*this->stride;
+        const int* below = this->currentLabels + iPlusOne*this->stride;
 
-        if (jFrom == this->width - 1) {
-            l13 = -1;
-            l23 = -1;
-            l33 = -1;
-        }
+        int l12 = above[jFrom];
+        int l13 = above[jPlusOne];
+        int l22 = row[jFrom];
+        int l23 = row[jPlusOne];
+        int l32 = below[jFrom];
+        int l33 = below[jPlusOne];
 
         if (l23 != l22 && l12 == l22 && l32 == l22) {
             return true;
@@ -921,9 +1468,14 @@ protected:
 
     /**
      * A copy of the image, it is converted to 8 bit channels corresponding
-     * to Lab color space.
+     * to the used color space; or the image of the caller, see externalImage.
      */
     cv::Mat* image;
+    /**
+     * Whether image references an image owned by the caller, which must neither
+     * be converted nor overwritten; see reset.
+     */
+    bool externalImage;
     /**
      * The height of the image.
      */
@@ -976,12 +1528,36 @@ protected:
      * The color space to use, see constants at the beginning of the class.
      */
     int colorSpace;
+    /**
+     * Whether the color channels are binned uniformly, see setUniformBinning.
+     */
+    bool uniformBinning;
+    /**
+     * The spatial memory mode, see setSpatialMemoryMode.
+     */
+    int spatialMemoryMode;
+    /**
+     * The desired number of superpixels if given on construction, otherwise 0.
+     * Used to derive number of levels and minimum block size for new images, see reset.
+     */
+    int desiredNumberOfSuperpixels;
     
     /**
      * The current labels: At pixel level these will be the current superpixels,
      * at a block level, these correspond to block labelings.
+     * 
+     * Stored row-major with stride, label (i, j) is found at currentLabels[i*stride + j].
+     * The plane is padded by one row and column of -1 labels on each side.
      */
-    int** currentLabels;
+    int* currentLabels;
+    /**
+     * Pointers to the rows of currentLabels, see getLabelArray.
+     */
+    int** labelRows;
+    /**
+     * Row stride of currentLabels and histogramBins.
+     */
+    int stride;
     /**
      * The current level.
      */
@@ -1024,13 +1600,50 @@ protected:
     bool initializedLabels;
 
     /**
-     * Color histograms at all levels including superpixels.
+     * Color histograms at all levels including superpixels. All histograms
+     * live in histogramArena, histograms[level - 1] points to the histogram
+     * of the first block at the given level; see getHistogram. NULL for
+     * narrow and sparse levels.
+     */
+    int** histograms;
+    /**
+     * Per-channel lookup tables from channel values to histogram bins, already
+     * multiplied by the number of bins of the preceding channels; kept such that
+     * the next frame is binned alike, see initializeFromPreviousFrame.
      */
-    int**** histograms;
+    int binLookup[3][256];
     /**
-     * Pixel counts for all blocks and superpixels.
+     * Superpixel histograms of the previous frame, kept to avoid reallocation,
+     * see initializeFromPreviousFrame.
      */
-    int*** pixels;
+    std::vector<int> previousHistograms;
+    /**
+     * 16 bit histograms of the levels numberOfSparseLevels + 1 to numberOfNarrowLevels,
+     * stored in front of the 32 bit histograms in histogramArena; see getNarrowHistogram.
+     * NULL for all other levels.
+     */
+    unsigned short** narrowHistograms;
+    /**
+     * Pixel counts for all blocks and superpixels, also stored in histogramArena;
+     * see getPixels.
+     */
+    int** pixels;
+    /**
+     * Number of blocks in horizontal direction for each level, used as row stride
+     * for histograms and pixels.
+     */
+    int* levelWidthNumbers;
+    /**
+     * Single aligned allocation holding all 16 bit histograms, all 32 bit
+     * histograms and all pixel counts.
+     */
+    unsigned char* histogramArena;
+    /**
+     * Distance in bins between two consecutive histograms in histogramArena,
+     * that is histogramSize rounded up such that every histogram is aligned
+     * regardless of its width.
+     */
+    int histogramStride;
     /**
      * The dimension of each histogram = 3 for color images.
      */
@@ -1040,18 +1653,106 @@ protected:
      */
     int histogramSize;
     /**
-     * The histogram bin assigned to each pixel stored in a two-dimensional array.
+     * Whether block histograms may be stored sparsely, see setSparseHistograms.
+     */
+    bool sparseHistograms;
+    /**
+     * The levels 1 to numberOfSparseLevels use sparse histograms, see getSparseHistogram.
+     */
+    int numberOfSparseLevels;
+    /**
+     * The blocks of the levels 1 to numberOfNarrowLevels have at most 65535 pixels,
+     * so their histograms use 16 bit bins; always at least numberOfSparseLevels.
      */
-    int** histogramBins;
+    int numberOfNarrowLevels;
+    /**
+     * Sparse histograms of the levels 1 to numberOfSparseLevels.
+     */
+    SparseLevel* sparseLevels;
+    /**
+     * Single aligned allocation holding all sparse histograms followed by their
+     * offsets and lengths.
+     */
+    unsigned char* sparseArena;
+    /**
+     * The histogram bin assigned to each pixel, stored like currentLabels.
+     */
+    unsigned short* histogramBins;
     /**
      * Boolean whether the histograms have been initialized.
      */
     bool initializedHistograms;
 
     /**
-     * Memory used to speed up the algorithm.
+     * Memory used to speed up the algorithm: blocks or pixels to be checked
+     * in the next sweep, padded like currentLabels.
+     */
+    SpatialMemory spatialMemory;
+    /**
+     * Pixels on a superpixel boundary, only these can change their label; maintained
+     * during the pixel updates such that the sweeps only visit the boundary pixels.
+     */
+    SpatialMemory boundary;
+
+    /**
+     * Fraction of blocks or pixels to be moved in an iteration to continue
+     * at the current level, see setMinimumChange.
+     */
+    float minimumChange;
+    /**
+     * Tick count (see cv::getTickCount) at which the iterations are stopped,
+     * 0 if there is no deadline; see iterateWithBudget.
      */
-    bool** spatialMemory;
+    int64 deadline;
+    /**
+     * Whether the last iterations have been stopped by the deadline.
+     */
+    bool deadlineExceeded;
+    /**
+     * Iterations run at each level, see getIterationsPerLevel.
+     */
+    std::vector<int> iterationsPerLevel;
+    /**
+     * Blocks or pixels moved at each level, see getMovesPerLevel.
+     */
+    std::vector<int> movesPerLevel;
+    
+    /**
+     * The number of threads to use, see setNumberOfThreads.
+     */
+    int numberOfThreads;
+    /**
+     * Proposed block updates when using parallel block updates, kept to avoid
+     * reallocation.
+     */
+    std::vector<Update> blockUpdates;
+    /**
+     * Strips used for parallel pixel updates.
+     */
+    std::vector<PixelStrip> pixelStrips;
+    /**
+     * Reciprocal pixel counts of the superpixels indexed by label, only valid
+     * if validPixelCache is set, see HistogramPixelPolicy::initializeCache.
+     */
+    std::vector<float> superpixelReciprocals;
+    /**
+     * Smoothing prior counts used by sequential pixel updates.
+     */
+    NeighborhoodCounts neighborhoodCounts;
+    /**
+     * Whether superpixelReciprocals, the means of SEEDSRevisedMeanPixels and
+     * neighborhoodCounts are up to date; reset whenever labels or superpixels
+     * are changed by anything but pixel updates, see SEEDSEngine::validateCache.
+     */
+    bool validPixelCache;
+    /**
+     * Kernel used to score block updates, chosen according to the CPU.
+     */
+    HistogramIntersection::Kernel intersectionKernel;
+    /**
+     * Kernel used to score block updates with 16 bit histograms.
+     */
+    HistogramIntersection::NarrowKernel narrowIntersectionKernel;
 };
 
 /**
@@ -1150,49 +1851,143 @@ public:
      * @param int iterations
      */
     virtual void iterate(int iterations);
+    
+    /**
+     * Perform one iteration of pixel updates using mean pixel updates.
+     * 
+     * @return int number of pixels moved
+     */
+    virtual int performPixelUpdates();
+    
+    /**
+     * Perform a mean pixel update for the given pixel.
+     * 
+     * @param int i
+     * @param int j
+     */
+    virtual void performPixelUpdate(int i, int j);
+    
+    /**
+     * Get the mean color of the given superpixel as tracked by the pixel updates,
+     * in the color space the algorithm works on (for color images, BGR input is
+     * converted to Lab when using BGR or LAB); only valid after iterate.
+     * 
+     * @param int label
+     * @param float* color array with one entry per channel
+     */
+    void getMeanColor(int label, float* color) const;
 
 protected:
+    
+    template <class PixelPolicy, int SpatialMemoryMode> friend class SEEDSEngine;
+    friend class MeanPixelPolicy;
 
     /**
      * Before pixel updates, the means need to be initialized.
      */
     virtual void initializeMeans();
+    
+    /**
+     * Free the means.
+     */
+    void releaseMeans();
+    
+    /**
+     * Compute colorFactor and spatialFactor from the normalizations of both
+     * distances and the spatial weight.
+     */
+    void computeScoreFactors();
+    
+    /**
+     * The means depend on the same configuration as the histograms and are
+     * released alongside.
+     */
+    virtual void releaseHistograms();
 
     /**
-     * Assign the given pixel to the new superpixel.
+     * Get the sums of the given dimension over all superpixels, indexed by
+     * label. The first histogramDimensions dimensions are the color channels,
+     * the last two dimensions are x and y.
      * 
-     * @param int iFrom
-     * @param int jFrom
-     * @param int iTo
-     * @param int jTo
-     * @param int iSuperpixelFrom
-     * @param int jSuperpixelFrom
-     * @param int iSuperpixelTo
-     * @param int jSuperpixelTo
-     * @param int iPlusOne
-     * @param int iMinusOne
-     * @param int jPlusOne
-     * @param int jMinusOne
+     * @param int k
+     * @return 
+     */
+    inline float* getMeanSums(int k) const {
+        #ifdef DEBUG
+            assert(k >= 0 && k < this->meanDimensions);
+        #endif
+        
+        return this->meanSums + k*this->meanStride;
+    }
+    
+    /**
+     * Get the means of the given dimension over all superpixels, indexed by
+     * label, see getMeanSums; only valid if validPixelCache is set, see
+     * MeanPixelPolicy::initializeCache.
+     * 
+     * @param int k
+     * @return 
      */
-    virtual inline void updatePixel(int iFrom, int jFrom, int iTo, int jTo, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo, int iPlusOne, int iMinusOne, int jPlusOne, int jMinusOne) {
+    inline float* getMeans(int k) const {
+        #ifdef DEBUG
+            assert(k >= 0 && k < this->meanDimensions);
+        #endif
+        
+        return this->meanSums + (this->meanDimensions + k)*this->meanStride;
+    }
 
-        SEEDSRevised::updatePixel(iFrom, jFrom, iTo, jTo, iSuperpixelFrom, jSuperpixelFrom, iSuperpixelTo, jSuperpixelTo, iPlusOne, iMinusOne, jPlusOne, jMinusOne);
+    /**
+     * Color and position of the pixels are not stored but taken from the image
+     * and the pixel coordinates; only the sums over the superpixels are kept
+     * with one array of meanStride entries per dimension, see getMeanSums,
+     * followed by the same arrays for the means, see getMeans.
+     */
+    int meanDimensions;
+    int meanStride;
+    float* meanSums;
+    bool initializedMeans;
+    float spatialWeight;
+    /**
+     * Factors of the squared color and spatial distances, including the
+     * normalization and the spatial weight, such that scoring only multiplies;
+     * see computeScoreFactors.
+     */
+    float colorFactor;
+    float spatialFactor;
 
-        for (int k = 0; k < this->meanDimensions; ++k) {
-            this->means[1][iSuperpixelFrom][jSuperpixelFrom][k] -= this->means[0][iFrom][jFrom][k];
-            this->means[1][iSuperpixelTo][jSuperpixelTo][k] += this->means[0][iFrom][jFrom][k];
-        }
+};
 
-        #ifdef DEBUG
-            float mean = 0.;
-            for (int k = 0; k < this->histogramDimensions; ++k) {
-                mean = this->means[1][iSuperpixelFrom][jSuperpixelFrom][k]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom];
-                assert(mean <= 255);
+/**
+ * Pixel policy of SEEDSRevised: pixels are scored by the color histograms of the
+ * superpixels, weighted by the number of pixels of the superpixels within the
+ * neighborhood (the smoothing prior).
+ */
+class HistogramPixelPolicy {
 
-                mean = this->means[1][iSuperpixelTo][jSuperpixelTo][k]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo];
-                assert(mean <= 255);
-            }
-        #endif
+public:
+    
+    /**
+     * Constructor.
+     * 
+     * @param SEEDSRevised seeds
+     */
+    HistogramPixelPolicy(SEEDSRevised* seeds) : seeds(seeds) {
+        
+    }
+    
+    /**
+     * Compute the reciprocal pixel counts of all superpixels; these are kept
+     * up to date by updatePixelStatistics such that scoring does not need
+     * to divide.
+     */
+    inline void initializeCache() {
+        int numberOfSuperpixels = this->seeds->superpixelHeightNumber*this->seeds->superpixelWidthNumber;
+        const int* pixels = &this->seeds->getPixels(this->seeds->numberOfLevels, 0, 0);
+        
+        this->seeds->superpixelReciprocals.resize(numberOfSuperpixels);
+        for (int label = 0; label < numberOfSuperpixels; ++label) {
+            this->seeds->superpixelReciprocals[label] = 1.f/pixels[label];
+        }
     }
 
     /**
@@ -1205,39 +2000,13 @@ protected:
      * @param int jSuperpixelFrom
      * @return 
      */
-    virtual inline float scoreCurrentPixelSegmentation(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom) {
-        float currentColorScore = 0.;
-
-        if (this->histogramDimensions == 1) {
-            float difference = this->means[1][iSuperpixelFrom][jSuperpixelFrom][0]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][0];
-
-            currentColorScore = difference*difference/this->colorNormalization;
-        }
-        else {
-            float differenceL = this->means[1][iSuperpixelFrom][jSuperpixelFrom][0]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][0];
-            float differenceA = this->means[1][iSuperpixelFrom][jSuperpixelFrom][1]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][1];
-            float differenceB = this->means[1][iSuperpixelFrom][jSuperpixelFrom][2]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][2];
-
-            currentColorScore = (differenceL*differenceL + differenceA*differenceA + differenceB*differenceB)/this->colorNormalization;
-        }
-
+    inline float scoreCurrentPixelSegmentation(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom) const {
         #ifdef DEBUG
-            assert(currentColorScore <= 1 && currentColorScore >= 0);
+            assert(this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]] <= this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom));
         #endif
 
-        if (this->spatialWeight > 0) {
-            float differenceX = this->means[1][iSuperpixelFrom][jSuperpixelFrom][this->meanDimensions - 2]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][this->meanDimensions - 2];
-            float differenceY = this->means[1][iSuperpixelFrom][jSuperpixelFrom][this->meanDimensions - 1]/this->pixels[this->numberOfLevels - 1][iSuperpixelFrom][jSuperpixelFrom] - this->means[0][iFrom][jFrom][this->meanDimensions - 1];
-            float currentSpatialScore = (differenceX*differenceX + differenceY*differenceY)/this->spatialNormalization;
-
-            #ifdef DEBUG
-                assert(currentSpatialScore <= 1 && currentSpatialScore >= 0);
-            #endif
-
-            return (1 - this->spatialWeight)*currentColorScore + this->spatialWeight*currentSpatialScore;
-        }
-            
-        return currentColorScore;
+        return this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]]
+                *this->seeds->superpixelReciprocals[iSuperpixelFrom*this->seeds->superpixelWidthNumber + jSuperpixelFrom];
     }
 
     /**
@@ -1250,79 +2019,205 @@ protected:
      * @param int jSuperpixelTo
      * @return 
      */
-    virtual inline float scoreProposedPixelSegmentation(int iFrom, int jFrom, int iSuperpixelTo, int jSuperpixelTo) {
-        float proposedColorScore = 0.;
+    inline float scoreProposedPixelSegmentation(int iFrom, int jFrom, int iSuperpixelTo, int jSuperpixelTo) const {
+        #ifdef DEBUG
+            assert(this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]] <= this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo));
+        #endif
 
-        if (this->histogramDimensions == 1) {
-            float difference = this->means[1][iSuperpixelTo][jSuperpixelTo][0]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][0];
+        return this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]]
+                *this->seeds->superpixelReciprocals[iSuperpixelTo*this->seeds->superpixelWidthNumber + jSuperpixelTo];
 
-            proposedColorScore = difference*difference/this->colorNormalization;
-        }
-        else {
-            float differenceL = this->means[1][iSuperpixelTo][jSuperpixelTo][0]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][0];
-            float differenceA = this->means[1][iSuperpixelTo][jSuperpixelTo][1]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][1];
-            float differenceB = this->means[1][iSuperpixelTo][jSuperpixelTo][2]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][2];
+    }
+
+    /**
+     * Add smoothing prior given the number of pixels of the current and the
+     * proposed superpixel within the neighborhood of the pixel, see
+     * SEEDSRevised::NeighborhoodCounts.
+     * 
+     * @param int countFrom
+     * @param int countTo
+     * @param float currentScore
+     * @param float proposedScore
+     * @return 
+     */
+    inline float scorePixelUpdate(int countFrom, int countTo, float currentScore, float proposedScore) const {
 
-            proposedColorScore = (differenceL*differenceL + differenceA*differenceA + differenceB*differenceB)/this->colorNormalization;
+        if (this->seeds->neighborhoodSize > 0) {
+            currentScore *= countFrom;
+            proposedScore *= countTo;
         }
 
+        return proposedScore - currentScore;
+    }
+
+    /**
+     * Move the given pixel from one superpixel to the other within the
+     * superpixel histograms (the labels are not changed).
+     * 
+     * @param int iFrom
+     * @param int jFrom
+     * @param int iSuperpixelFrom
+     * @param int jSuperpixelFrom
+     * @param int iSuperpixelTo
+     * @param int jSuperpixelTo
+     */
+    inline void updatePixelStatistics(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo) {
+        int pixelsFrom = --this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom);
+        int pixelsTo = ++this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo);
+        
+        this->seeds->superpixelReciprocals[iSuperpixelFrom*this->seeds->superpixelWidthNumber + jSuperpixelFrom] = 1.f/pixelsFrom;
+        this->seeds->superpixelReciprocals[iSuperpixelTo*this->seeds->superpixelWidthNumber + jSuperpixelTo] = 1.f/pixelsTo;
+
+        --this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]];
+        ++this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo)[this->seeds->histogramBins[iFrom*this->seeds->stride + jFrom]];
+
         #ifdef DEBUG
-            assert(proposedColorScore <= 1 && proposedColorScore >= 0);
+            int sumFrom = 0;
+            int sumTo = 0;
+            for (int k = 0; k < this->seeds->histogramSize; ++k) {
+                sumFrom += this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom)[k];
+                sumTo += this->seeds->getHistogram(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo)[k];
+            }
+
+            assert(sumFrom == this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom));
+            assert(sumTo == this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo));
         #endif
+    }
 
-        if (this->spatialWeight > 0) {
-            float differenceX = this->means[1][iSuperpixelTo][jSuperpixelTo][this->meanDimensions - 2]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][this->meanDimensions - 2];
-            float differenceY = this->means[1][iSuperpixelTo][jSuperpixelTo][this->meanDimensions - 1]/this->pixels[this->numberOfLevels - 1][iSuperpixelTo][jSuperpixelTo] - this->means[0][iFrom][jFrom][this->meanDimensions - 1];
-            float proposedSpatialScore = (differenceX*differenceX + differenceY*differenceY)/this->spatialNormalization;
+private:
+    
+    SEEDSRevised* seeds;
+};
 
-            #ifdef DEBUG
-                assert(proposedSpatialScore <= 1 && proposedSpatialScore >= 0);
-            #endif
+/**
+ * Pixel policy of SEEDSRevisedMeanPixels: pixels are scored by the color and
+ * spatial distance to the superpixel means, the smoothing prior is used as for
+ * HistogramPixelPolicy. The color histograms are kept up to date as well.
+ */
+class MeanPixelPolicy {
 
-            return (1 - this->spatialWeight)*proposedColorScore + this->spatialWeight*proposedSpatialScore;
-        }
+public:
+    
+    /**
+     * Constructor.
+     * 
+     * @param SEEDSRevisedMeanPixels seeds
+     */
+    MeanPixelPolicy(SEEDSRevisedMeanPixels* seeds) : histogramPolicy(seeds), seeds(seeds) {
+        
+    }
+    
+    /**
+     * Compute the means of all superpixels from the sums; these are kept up
+     * to date by updatePixelStatistics such that scoring does not need to divide.
+     */
+    inline void initializeCache() {
+        this->histogramPolicy.initializeCache();
+        
+        int numberOfSuperpixels = this->seeds->superpixelHeightNumber*this->seeds->superpixelWidthNumber;
+        const int* pixels = &this->seeds->getPixels(this->seeds->numberOfLevels, 0, 0);
+        
+        for (int k = 0; k < this->seeds->meanDimensions; ++k) {
+            const float* sums = this->seeds->getMeanSums(k);
+            float* means = this->seeds->getMeans(k);
             
-        return proposedColorScore;
+            for (int label = 0; label < numberOfSuperpixels; ++label) {
+                means[label] = sums[label]/pixels[label];
+            }
+        }
     }
 
     /**
-     * Add smoothing prior.
+     * Move the given pixel from one superpixel to the other within the
+     * superpixel histograms and means (the labels are not changed).
      * 
      * @param int iFrom
      * @param int jFrom
-     * @param int iTo
-     * @param int jTo
-     * @param float currentScore
-     * @param float proposedScore
-     * @return 
+     * @param int iSuperpixelFrom
+     * @param int jSuperpixelFrom
+     * @param int iSuperpixelTo
+     * @param int jSuperpixelTo
      */
-    virtual inline float scorePixelUpdate(int iFrom, int jFrom, int iTo, int jTo, float currentScore, float proposedScore) {
+    inline void updatePixelStatistics(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom, int iSuperpixelTo, int jSuperpixelTo) {
 
-        if (this->neighborhoodSize > 0) {
+        this->histogramPolicy.updatePixelStatistics(iFrom, jFrom, iSuperpixelFrom, jSuperpixelFrom, iSuperpixelTo, jSuperpixelTo);
 
-            int countFrom = 0;
-            int countTo = 0;
+        int labelFrom = iSuperpixelFrom*this->seeds->superpixelWidthNumber + jSuperpixelFrom;
+        int labelTo = iSuperpixelTo*this->seeds->superpixelWidthNumber + jSuperpixelTo;
+        const unsigned char* color = this->seeds->image->ptr(iFrom) + jFrom*this->seeds->histogramDimensions;
+        
+        for (int k = 0; k < this->seeds->histogramDimensions; ++k) {
+            this->seeds->getMeanSums(k)[labelFrom] -= color[k];
+            this->seeds->getMeanSums(k)[labelTo] += color[k];
+        }
+        
+        this->seeds->getMeanSums(this->seeds->meanDimensions - 2)[labelFrom] -= jFrom;
+        this->seeds->getMeanSums(this->seeds->meanDimensions - 2)[labelTo] += jFrom;
+        this->seeds->getMeanSums(this->seeds->meanDimensions - 1)[labelFrom] -= iFrom;
+        this->seeds->getMeanSums(this->seeds->meanDimensions - 1)[labelTo] += iFrom;
+        
+        int pixelsFrom = this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelFrom, jSuperpixelFrom);
+        int pixelsTo = this->seeds->getPixels(this->seeds->numberOfLevels, iSuperpixelTo, jSuperpixelTo);
+        
+        for (int k = 0; k < this->seeds->meanDimensions; ++k) {
+            this->seeds->getMeans(k)[labelFrom] = this->seeds->getMeanSums(k)[labelFrom]/pixelsFrom;
+            this->seeds->getMeans(k)[labelTo] = this->seeds->getMeanSums(k)[labelTo]/pixelsTo;
+        }
 
-            int labelFrom = this->currentLabels[iFrom][jFrom];
-            int labelTo = this->currentLabels[iTo][jTo];
+        #ifdef DEBUG
+            float mean = 0.;
+            for (int k = 0; k < this->seeds->histogramDimensions; ++k) {
+                mean = this->seeds->getMeans(k)[labelFrom];
+                assert(mean <= 255);
 
-            int iStart = std::max(0, std::min(iFrom, iTo) - this->neighborhoodSize);
-            int iEnd = std::min(this->currentBlockHeightNumber, std::max(iFrom, iTo) + this->neighborhoodSize + 1);
+                mean = this->seeds->getMeans(k)[labelTo];
+                assert(mean <= 255);
+            }
+        #endif
+    }
 
-            int jStart = std::max(0, std::min(jFrom, jTo) - this->neighborhoodSize);
-            int jEnd = std::min(this->currentBlockWidthNumber, std::max(jFrom, jTo) + this->neighborhoodSize + 1);
+    /**
+     * Compute the probability of the current pixel belonging to the given
+     * superpixel.
+     * 
+     * @param int iFrom
+     * @param int jFrom
+     * @param int iSuperpixelFrom
+     * @param int jSuperpixelFrom
+     * @return 
+     */
+    inline float scoreCurrentPixelSegmentation(int iFrom, int jFrom, int iSuperpixelFrom, int jSuperpixelFrom) const {
+        return this->scorePixelSegmentation(iFrom, jFrom, iSuperpixelFrom, jSuperpixelFrom);
+    }
 
-            for (int i = iStart; i < iEnd; ++i) {
-                for (int j = jStart; j < jEnd; ++j) {
-                    if (this->currentLabels[i][j] == labelFrom) {
-                        ++countFrom;
-                    }
-                    else if (this->currentLabels[i][j] == labelTo) {
-                        ++countTo;
-                    }
-                }
-            }
+    /**
+     * Compute the probability of the current pixel belonging to the
+     * new superpixel.
+     * 
+     * @param int iFrom
+     * @param int jFrom
+     * @param int iSuperpixelTo
+     * @param int jSuperpixelTo
+     * @return 
+     */
+    inline float scoreProposedPixelSegmentation(int iFrom, int jFrom, int iSuperpixelTo, int jSuperpixelTo) const {
+        return this->scorePixelSegmentation(iFrom, jFrom, iSuperpixelTo, jSuperpixelTo);
+    }
 
+    /**
+     * Add smoothing prior given the number of pixels of the current and the
+     * proposed superpixel within the neighborhood of the pixel, see
+     * SEEDSRevised::NeighborhoodCounts.
+     * 
+     * @param int countFrom
+     * @param int countTo
+     * @param float currentScore
+     * @param float proposedScore
+     * @return 
+     */
+    inline float scorePixelUpdate(int countFrom, int countTo, float currentScore, float proposedScore) const {
+
+        if (this->seeds->neighborhoodSize > 0) {
             currentScore /= countFrom;
             proposedScore /= countTo;
         }
@@ -1330,13 +2225,59 @@ protected:
         return currentScore - proposedScore;
     }
 
-    int meanDimensions;
-    float**** means;
-    bool initializedMeans;
-    float colorNormalization;
-    float spatialWeight;
-    float spatialNormalization;
+private:
+    
+    /**
+     * Weighted color and spatial distance between the given pixel and the mean
+     * of the given superpixel. The color of the pixel is read from the image
+     * and its position is given by (iFrom, jFrom).
+     * 
+     * @param int iFrom
+     * @param int jFrom
+     * @param int iSuperpixel
+     * @param int jSuperpixel
+     * @return 
+     */
+    inline float scorePixelSegmentation(int iFrom, int jFrom, int iSuperpixel, int jSuperpixel) const {
+        int label = iSuperpixel*this->seeds->superpixelWidthNumber + jSuperpixel;
+        const unsigned char* color = this->seeds->image->ptr(iFrom) + jFrom*this->seeds->histogramDimensions;
+        
+        float colorScore = 0.;
+
+        if (this->seeds->histogramDimensions == 1) {
+            float difference = this->seeds->getMeans(0)[label] - color[0];
+
+            colorScore = difference*difference*this->seeds->colorFactor;
+        }
+        else {
+            float differenceL = this->seeds->getMeans(0)[label] - color[0];
+            float differenceA = this->seeds->getMeans(1)[label] - color[1];
+            float differenceB = this->seeds->getMeans(2)[label] - color[2];
 
+            colorScore = (differenceL*differenceL + differenceA*differenceA + differenceB*differenceB)*this->seeds->colorFactor;
+        }
+
+        #ifdef DEBUG
+            assert(colorScore <= 1 && colorScore >= 0);
+        #endif
+
+        if (this->seeds->spatialWeight > 0) {
+            float differenceX = this->seeds->getMeans(this->seeds->meanDimensions - 2)[label] - jFrom;
+            float differenceY = this->seeds->getMeans(this->seeds->meanDimensions - 1)[label] - iFrom;
+            float spatialScore = (differenceX*differenceX + differenceY*differenceY)*this->seeds->spatialFactor;
+
+            #ifdef DEBUG
+                assert(spatialScore <= 1 && spatialScore >= 0);
+            #endif
+
+            return colorScore + spatialScore;
+        }
+            
+        return colorScore;
+    }
+    
+    HistogramPixelPolicy histogramPolicy;
+    SEEDSRevisedMeanPixels* seeds;
 };
 
 #endif	/* SEEDS_REVISED_H */
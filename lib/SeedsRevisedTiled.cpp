@@ -0,0 +1,384 @@
+/**
+ * Tiled oversegmentation of large images using SEEDSRevisedMeanPixels,
+ * see SEEDSRevisedTiled.
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "SeedsRevisedTiled.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <assert.h>
+
+SEEDSRevisedTiled::SEEDSRevisedTiled(int desiredNumberOfSuperpixels, int tileSize, int overlap, int numberOfBins, int neighborhoodSize, float minimumConfidence, float spatialWeight, int colorSpace) {
+    assert(desiredNumberOfSuperpixels > 0);
+    assert(tileSize > 0);
+    assert(overlap >= 0);
+    
+    this->desiredNumberOfSuperpixels = desiredNumberOfSuperpixels;
+    this->tileSize = tileSize;
+    this->overlap = overlap;
+    this->numberOfBins = numberOfBins;
+    this->neighborhoodSize = neighborhoodSize;
+    this->minimumConfidence = minimumConfidence;
+    this->spatialWeight = spatialWeight;
+    this->colorSpace = colorSpace;
+    
+    this->numberOfLevels = 0;
+    this->minimumBlockWidth = 0;
+    this->minimumBlockHeight = 0;
+    this->numberOfThreads = 1;
+    this->tileRows = 0;
+    this->tileColumns = 0;
+    this->numberOfSuperpixels = 0;
+}
+
+SEEDSRevisedTiled::~SEEDSRevisedTiled() {
+    
+}
+
+void SEEDSRevisedTiled::setNumberOfThreads(int numberOfThreads) {
+    assert(numberOfThreads > 0);
+    
+    this->numberOfThreads = numberOfThreads;
+}
+
+int SEEDSRevisedTiled::getNumberOfSuperpixels() const {
+    return this->numberOfSuperpixels;
+}
+
+int SEEDSRevisedTiled::getNumberOfTiles() const {
+    return this->tiles.size();
+}
+
+void SEEDSRevisedTiled::computeTiles(int height, int width) {
+    
+    // The remainder is distributed over all tiles such that no tile is
+    // smaller than tileSize (unless the image is).
+    this->tileRows = std::max(1, height/this->tileSize);
+    this->tileColumns = std::max(1, width/this->tileSize);
+    this->tiles.resize(this->tileRows*this->tileColumns);
+    
+    int minimumRegionHeight = height;
+    int minimumRegionWidth = width;
+    
+    for (int k = 0; k < this->tileRows; ++k) {
+        for (int l = 0; l < this->tileColumns; ++l) {
+            Tile &tile = this->tiles[k*this->tileColumns + l];
+            
+            tile.iStart = (k*height)/this->tileRows;
+            tile.iEnd = ((k + 1)*height)/this->tileRows;
+            tile.jStart = (l*width)/this->tileColumns;
+            tile.jEnd = ((l + 1)*width)/this->tileColumns;
+            
+            tile.regionIStart = std::max(0, tile.iStart - this->overlap);
+            tile.regionIEnd = std::min(height, tile.iEnd + this->overlap);
+            tile.regionJStart = std::max(0, tile.jStart - this->overlap);
+            tile.regionJEnd = std::min(width, tile.jEnd + this->overlap);
+            
+            minimumRegionHeight = std::min(minimumRegionHeight, tile.regionIEnd - tile.regionIStart);
+            minimumRegionWidth = std::min(minimumRegionWidth, tile.regionJEnd - tile.regionJStart);
+        }
+    }
+    
+    // The desired number of superpixels is scaled to the smallest region,
+    // larger regions get proportionally more superpixels of the same size.
+    double fraction = ((double) minimumRegionHeight*minimumRegionWidth)/((double) height*width);
+    int desiredNumberOfSuperpixels = std::max(1, (int) (this->desiredNumberOfSuperpixels*fraction + 0.5));
+    
+    SEEDSRevised::computeBlockSize(minimumRegionWidth, minimumRegionHeight, desiredNumberOfSuperpixels, 
+            this->numberOfLevels, this->minimumBlockWidth, this->minimumBlockHeight);
+}
+
+/**
+ * Oversegments the tiles in the given range, reusing a single SEEDSRevisedMeanPixels
+ * object, and copies the labels of each tile to labels.
+ */
+class SEEDSRevisedTiled::TileInvoker : public cv::ParallelLoopBody {
+    
+public:
+    
+    TileInvoker(SEEDSRevisedTiled* tiled, const cv::Mat &image, int iterations, cv::Mat_<int> &labels) 
+            : tiled(tiled), image(image), iterations(iterations), labels(labels) {
+        
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        SEEDSRevisedMeanPixels* seeds = NULL;
+        
+        for (int t = range.start; t < range.end; ++t) {
+            Tile &tile = this->tiled->tiles[t];
+            cv::Mat region = this->image(cv::Range(tile.regionIStart, tile.regionIEnd), cv::Range(tile.regionJStart, tile.regionJEnd));
+            
+            if (seeds == NULL) {
+                seeds = new SEEDSRevisedMeanPixels(region, this->tiled->numberOfLevels, this->tiled->minimumBlockWidth, 
+                        this->tiled->minimumBlockHeight, this->tiled->numberOfBins, this->tiled->neighborhoodSize, 
+                        this->tiled->minimumConfidence, this->tiled->spatialWeight, this->tiled->colorSpace);
+            }
+            else {
+                seeds->reset(region);
+            }
+            
+            seeds->initialize();
+            seeds->iterate(this->iterations);
+            
+            const cv::Mat_<int> regionLabels = seeds->getLabels();
+            tile.numberOfSuperpixels = seeds->getNumberOfSuperpixels();
+            tile.used.assign(tile.numberOfSuperpixels, false);
+            
+            for (int i = tile.iStart; i < tile.iEnd; ++i) {
+                const int* regionRow = regionLabels.ptr<int>(i - tile.regionIStart) - tile.regionJStart;
+                int* row = this->labels.ptr<int>(i);
+                
+                for (int j = tile.jStart; j < tile.jEnd; ++j) {
+                    row[j] = regionRow[j];
+                    tile.used[regionRow[j]] = true;
+                }
+            }
+            
+            // The labels just outside the tile are kept to stitch the seams.
+            tile.top.clear();
+            tile.bottom.clear();
+            tile.left.clear();
+            tile.right.clear();
+            
+            if (tile.iStart > tile.regionIStart) {
+                const int* regionRow = regionLabels.ptr<int>(tile.iStart - 1 - tile.regionIStart) - tile.regionJStart;
+                tile.top.assign(regionRow + tile.jStart, regionRow + tile.jEnd);
+            }
+            
+            if (tile.iEnd < tile.regionIEnd) {
+                const int* regionRow = regionLabels.ptr<int>(tile.iEnd - tile.regionIStart) - tile.regionJStart;
+                tile.bottom.assign(regionRow + tile.jStart, regionRow + tile.jEnd);
+            }
+            
+            for (int i = tile.iStart; i < tile.iEnd; ++i) {
+                const int* regionRow = regionLabels.ptr<int>(i - tile.regionIStart) - tile.regionJStart;
+                
+                if (tile.jStart > tile.regionJStart) {
+                    tile.left.push_back(regionRow[tile.jStart - 1]);
+                }
+                
+                if (tile.jEnd < tile.regionJEnd) {
+                    tile.right.push_back(regionRow[tile.jEnd]);
+                }
+            }
+        }
+        
+        delete seeds;
+    }
+    
+private:
+    
+    SEEDSRevisedTiled* tiled;
+    const cv::Mat &image;
+    int iterations;
+    cv::Mat_<int> &labels;
+};
+
+/**
+ * Replaces the labels of the tiles in the given range by their final labels.
+ */
+class SEEDSRevisedTiled::RelabelInvoker : public cv::ParallelLoopBody {
+    
+public:
+    
+    RelabelInvoker(const SEEDSRevisedTiled* tiled, const int* newLabels, cv::Mat_<int> &labels)
+            : tiled(tiled), newLabels(newLabels), labels(labels) {
+        
+    }
+    
+    virtual void operator()(const cv::Range &range) const {
+        for (int t = range.start; t < range.end; ++t) {
+            const Tile &tile = this->tiled->tiles[t];
+            const int* tileLabels = this->newLabels + tile.offset;
+            
+            for (int i = tile.iStart; i < tile.iEnd; ++i) {
+                int* row = this->labels.ptr<int>(i);
+                
+                for (int j = tile.jStart; j < tile.jEnd; ++j) {
+                    row[j] = tileLabels[row[j]];
+                }
+            }
+        }
+    }
+    
+private:
+    
+    const SEEDSRevisedTiled* tiled;
+    const int* newLabels;
+    cv::Mat_<int> &labels;
+};
+
+int SEEDSRevisedTiled::find(std::vector<int> &parents, int label) {
+    while (parents[label] != label) {
+        parents[label] = parents[parents[label]];
+        label = parents[label];
+    }
+    
+    return label;
+}
+
+void SEEDSRevisedTiled::mergeSeam(const cv::Mat_<int> &labels, const Tile &first, const Tile &second, std::vector<int> &parents) {
+    
+    bool horizontal = (second.jStart == first.jEnd);
+    const std::vector<int> &firstOutside = (horizontal ? first.right : first.bottom);
+    const std::vector<int> &secondOutside = (horizontal ? second.left : second.top);
+    
+    if (firstOutside.empty() || secondOutside.empty()) {
+        return;
+    }
+    
+    // Count the pixel pairs across the seam both tiles assign to the same superpixel.
+    std::map<std::pair<int, int>, int> counts;
+    int length = firstOutside.size();
+    
+    for (int k = 0; k < length; ++k) {
+        int firstLabel = (horizontal ? labels.ptr<int>(first.iStart + k)[first.jEnd - 1] : labels.ptr<int>(first.iEnd - 1)[first.jStart + k]);
+        int secondLabel = (horizontal ? labels.ptr<int>(second.iStart + k)[second.jStart] : labels.ptr<int>(second.iStart)[second.jStart + k]);
+        
+        if (firstOutside[k] == firstLabel && secondOutside[k] == secondLabel) {
+            ++counts[std::make_pair(first.offset + firstLabel, second.offset + secondLabel)];
+        }
+    }
+    
+    // Each superpixel is merged with at most one superpixel on the other side,
+    // pairs sharing more pixels are preferred.
+    std::vector<std::pair<int, std::pair<int, int> > > pairs;
+    for (std::map<std::pair<int, int>, int>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+        pairs.push_back(std::make_pair(-it->second, it->first));
+    }
+    
+    std::sort(pairs.begin(), pairs.end());
+    
+    std::set<int> firstMerged;
+    std::set<int> secondMerged;
+    
+    for (unsigned int k = 0; k < pairs.size(); ++k) {
+        int firstLabel = pairs[k].second.first;
+        int secondLabel = pairs[k].second.second;
+        
+        if (firstMerged.count(firstLabel) > 0 || secondMerged.count(secondLabel) > 0) {
+            continue;
+        }
+        
+        firstMerged.insert(firstLabel);
+        secondMerged.insert(secondLabel);
+        
+        int firstRoot = SEEDSRevisedTiled::find(parents, firstLabel);
+        int secondRoot = SEEDSRevisedTiled::find(parents, secondLabel);
+        
+        if (firstRoot < secondRoot) {
+            parents[secondRoot] = firstRoot;
+        }
+        else if (secondRoot < firstRoot) {
+            parents[firstRoot] = secondRoot;
+        }
+    }
+}
+
+int SEEDSRevisedTiled::oversegment(const cv::Mat &image, int iterations, cv::Mat_<int> &labels) {
+    assert(!image.empty());
+    
+    // Checked before the tiles are segmented in parallel, see SEEDSRevised::setNumberOfBins.
+    CV_Assert(this->numberOfBins > 0 && this->numberOfBins <= SEEDSRevised::getMaximumNumberOfBins(image.channels()));
+    
+    this->computeTiles(image.rows, image.cols);
+    labels.create(image.rows, image.cols);
+    
+    int numberOfTiles = this->tiles.size();
+    
+    if (this->numberOfThreads <= 1) {
+        TileInvoker(this, image, iterations, labels)(cv::Range(0, numberOfTiles));
+    }
+    else {
+        cv::parallel_for_(cv::Range(0, numberOfTiles), TileInvoker(this, image, iterations, labels), this->numberOfThreads);
+    }
+    
+    // Labels are made globally unique by offsetting the labels of each tile.
+    int numberOfLabels = 0;
+    for (int t = 0; t < numberOfTiles; ++t) {
+        this->tiles[t].offset = numberOfLabels;
+        numberOfLabels += this->tiles[t].numberOfSuperpixels;
+    }
+    
+    std::vector<int> parents(numberOfLabels);
+    for (int label = 0; label < numberOfLabels; ++label) {
+        parents[label] = label;
+    }
+    
+    for (int k = 0; k < this->tileRows; ++k) {
+        for (int l = 0; l < this->tileColumns; ++l) {
+            const Tile &tile = this->tiles[k*this->tileColumns + l];
+            
+            if (l + 1 < this->tileColumns) {
+                SEEDSRevisedTiled::mergeSeam(labels, tile, this->tiles[k*this->tileColumns + l + 1], parents);
+            }
+            
+            if (k + 1 < this->tileRows) {
+                SEEDSRevisedTiled::mergeSeam(labels, tile, this->tiles[(k + 1)*this->tileColumns + l], parents);
+            }
+        }
+    }
+    
+    // Consecutive labels are assigned in the order of the tiles, labels not
+    // occurring within their tile are skipped.
+    std::vector<int> newLabels(numberOfLabels, -1);
+    std::vector<int> rootLabels(numberOfLabels, -1);
+    this->numberOfSuperpixels = 0;
+    
+    for (int t = 0; t < numberOfTiles; ++t) {
+        const Tile &tile = this->tiles[t];
+        
+        for (int label = 0; label < tile.numberOfSuperpixels; ++label) {
+            if (tile.used[label]) {
+                int root = SEEDSRevisedTiled::find(parents, tile.offset + label);
+                
+                if (rootLabels[root] < 0) {
+                    rootLabels[root] = this->numberOfSuperpixels;
+                    ++this->numberOfSuperpixels;
+                }
+                
+                newLabels[tile.offset + label] = rootLabels[root];
+            }
+        }
+    }
+    
+    RelabelInvoker relabel(this, &newLabels[0], labels);
+    if (this->numberOfThreads <= 1) {
+        relabel(cv::Range(0, numberOfTiles));
+    }
+    else {
+        cv::parallel_for_(cv::Range(0, numberOfTiles), relabel, this->numberOfThreads);
+    }
+    
+    return this->numberOfSuperpixels;
+}
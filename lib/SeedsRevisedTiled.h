@@ -0,0 +1,243 @@
+/**
+ * Tiled oversegmentation of large images using SEEDSRevisedMeanPixels,
+ * see SEEDSRevisedTiled.
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SEEDS_REVISED_TILED_H
+#define	SEEDS_REVISED_TILED_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "SeedsRevised.h"
+
+/**
+ * Class SEEDSRevisedTiled oversegments images too large to be handled by a
+ * single SEEDSRevised object, for example slide scanner or satellite images.
+ * 
+ * The image is divided into a grid of tiles of roughly tileSize x tileSize
+ * pixels. Each tile is oversegmented independently, together with a margin
+ * of overlap pixels on each side, by a SEEDSRevisedMeanPixels object. Tiles
+ * may be processed in parallel, each thread reuses a single object for all
+ * its tiles such that the memory needed besides the image and the labels is
+ * proportional to the tile size and the number of threads.
+ * 
+ * The labels of each tile are offset to be globally unique. Afterwards, superpixels
+ * of adjacent tiles are stitched across the seam: two neighboring pixels on
+ * both sides of the seam are considered to belong to the same superpixel if both
+ * tiles - using their margin - agree on this. For each superpixel, the superpixel
+ * on the other side of the seam sharing most of these pixels is merged with
+ * it, such that superpixels are not cut at the seam. Finally, the labels are
+ * relabeled to be consecutive.
+ * 
+ * All tiles use the same number of levels and minimum block size, derived from
+ * the smallest tile, such that the size of the superpixels does not depend on
+ * the tile.
+ * 
+ * Usage:
+ * 
+ *  SEEDSRevisedTiled seeds(superpixels, 1024, 32);
+ *  int numberOfSuperpixels = seeds.oversegment(image, iterations, labels);
+ * 
+ * @author David Stutz
+ */
+class SEEDSRevisedTiled {
+    
+public:
+    
+    /**
+     * Constructor, instantiates a new SEEDSRevisedTiled object with the given
+     * parameters.
+     * 
+     * @param int desiredNumberOfSuperpixels desired number of superpixels for the whole image
+     * @param int tileSize minimum width and height of the tiles
+     * @param int overlap number of pixels the tiles are extended on each side, at least 1 to stitch superpixels across seams
+     * @param int numberOfBins number of bins for the color histograms
+     * @param int neighborhoodSize the (2*neighborhoodSize + 2) x (2*neighborhoodSize + 1) region around a pixel used for the smoothing prior
+     * @param float minimumConfidence minimum difference in histogram intersection needed to accept a block update
+     * @param float spatialWeight weight of spatial term for compact superpixels, float between 0 and 1
+     * @param int colorSpace color space to use, see SEEDSRevised
+     */
+    SEEDSRevisedTiled(int desiredNumberOfSuperpixels, int tileSize = 1024, int overlap = 32, int numberOfBins = 5, int neighborhoodSize = 1, float minimumConfidence = 0.1, float spatialWeight = 0.25, int colorSpace = SEEDSRevised::BGR);
+    
+    /**
+     * Destructor.
+     */
+    virtual ~SEEDSRevisedTiled();
+    
+    /**
+     * Set the number of tiles oversegmented in parallel. The tiles are distributed
+     * using OpenCV's parallel_for_, the number of threads is used as number
+     * of stripes. The result does not depend on the number of threads.
+     * 
+     * @param int numberOfThreads
+     */
+    void setNumberOfThreads(int numberOfThreads);
+    
+    /**
+     * Oversegment the given image.
+     * 
+     * @param cv::Mat image image to be oversegmented
+     * @param int iterations iterations at each level for each tile
+     * @param cv::Mat_<int> labels resulting labels, allocated if necessary
+     * @return number of superpixels
+     */
+    int oversegment(const cv::Mat &image, int iterations, cv::Mat_<int> &labels);
+    
+    /**
+     * Get the number of superpixels of the last oversegmentation.
+     * 
+     * @return
+     */
+    int getNumberOfSuperpixels() const;
+    
+    /**
+     * Get the number of tiles used for the last oversegmentation.
+     * 
+     * @return
+     */
+    int getNumberOfTiles() const;
+    
+protected:
+    
+    /**
+     * A tile consists of the pixels [iStart, iEnd) x [jStart, jEnd) it labels
+     * and the region it is oversegmented with, which is extended by the overlap.
+     */
+    struct Tile {
+        int iStart;
+        int iEnd;
+        int jStart;
+        int jEnd;
+        int regionIStart;
+        int regionIEnd;
+        int regionJStart;
+        int regionJEnd;
+        
+        /**
+         * Number of superpixels of the tile and offset of its labels.
+         */
+        int numberOfSuperpixels;
+        int offset;
+        
+        /**
+         * Whether a label of the tile occurs within [iStart, iEnd) x [jStart, jEnd).
+         */
+        std::vector<bool> used;
+        
+        /**
+         * Labels of the tile for the rows iStart - 1 and iEnd and the columns
+         * jStart - 1 and jEnd, empty if outside of the region.
+         */
+        std::vector<int> top;
+        std::vector<int> bottom;
+        std::vector<int> left;
+        std::vector<int> right;
+    };
+    
+    class TileInvoker;
+    class RelabelInvoker;
+    
+    /**
+     * Divide an image of the given size into tiles and derive the number of
+     * levels and the minimum block size from the smallest tile.
+     * 
+     * @param int height
+     * @param int width
+     */
+    void computeTiles(int height, int width);
+    
+    /**
+     * Merge the superpixels across the seam between the two given tiles, where
+     * second is either the right or the bottom neighbor of first.
+     * 
+     * @param cv::Mat_<int> labels labels of all tiles, not yet offset
+     * @param Tile first
+     * @param Tile second
+     * @param std::vector<int> parents union find structure over all labels
+     */
+    static void mergeSeam(const cv::Mat_<int> &labels, const Tile &first, const Tile &second, std::vector<int> &parents);
+    
+    /**
+     * Find the representative of the given label and compress the path.
+     * 
+     * @param std::vector<int> parents
+     * @param int label
+     * @return
+     */
+    static int find(std::vector<int> &parents, int label);
+    
+    /**
+     * Desired number of superpixels for the whole image.
+     */
+    int desiredNumberOfSuperpixels;
+    
+    /**
+     * Minimum size of the tiles and overlap on each side.
+     */
+    int tileSize;
+    int overlap;
+    
+    /**
+     * Parameters passed to SEEDSRevisedMeanPixels.
+     */
+    int numberOfBins;
+    int neighborhoodSize;
+    float minimumConfidence;
+    float spatialWeight;
+    int colorSpace;
+    
+    /**
+     * Number of levels and minimum block size used for all tiles.
+     */
+    int numberOfLevels;
+    int minimumBlockWidth;
+    int minimumBlockHeight;
+    
+    /**
+     * Number of tiles oversegmented in parallel.
+     */
+    int numberOfThreads;
+    
+    /**
+     * Tiles of the last oversegmentation in row major order.
+     */
+    int tileRows;
+    int tileColumns;
+    std::vector<Tile> tiles;
+    
+    /**
+     * Number of superpixels of the last oversegmentation.
+     */
+    int numberOfSuperpixels;
+};
+
+#endif	/* SEEDS_REVISED_TILED_H */
@@ -0,0 +1,289 @@
+/**
+ * Bitset of blocks or pixels to be checked again, used by SEEDSRevised,
+ * see SpatialMemory.
+ * 
+ * The code is published under the BSD 3-Clause:
+ * 
+ * Copyright (c) 2014 - 2015, David Stutz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SEEDS_REVISED_SPATIAL_MEMORY_H
+#define	SEEDS_REVISED_SPATIAL_MEMORY_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+#endif
+
+/**
+ * Class SpatialMemory remembers which blocks or pixels need to be checked in the
+ * next sweep, one bit per cell. As the bits of a row are packed into words, a
+ * sweep can skip all inactive cells of 64 columns at once using next, such that
+ * later sweeps only cost the number of active cells plus one word per 64 cells.
+ * 
+ * Like the label plane, the bitset has one row and column of padding on each
+ * side, so cells (-1, j), (height, j), (i, -1) and (i, width) may be set. Each
+ * row starts a new word, so different rows can be updated by different threads.
+ * 
+ * The same bitset is used to keep track of the pixels on superpixel boundaries.
+ * 
+ * @author David Stutz
+ */
+class SpatialMemory {
+
+public:
+    
+    /**
+     * Constructor, allocate needs to be called before use.
+     */
+    SpatialMemory() : wordsPerRow(0) {
+        
+    }
+    
+    /**
+     * Allocate the bitset for the given size, all bits are cleared.
+     * 
+     * @param int height
+     * @param int width
+     */
+    void allocate(int height, int width) {
+        this->wordsPerRow = (width + 2 + 63)/64;
+        this->words.assign((height + 2)*this->wordsPerRow, 0);
+    }
+    
+    /**
+     * Free the bitset.
+     */
+    void release() {
+        std::vector<uint64_t>().swap(this->words);
+        this->wordsPerRow = 0;
+    }
+    
+    /**
+     * Clear all bits including the padding.
+     */
+    void clear() {
+        std::fill(this->words.begin(), this->words.end(), 0);
+    }
+    
+    /**
+     * Set the bits of all cells (i, j) with 0 <= i < height and 0 <= j < width.
+     * 
+     * @param int height
+     * @param int width
+     */
+    void setAll(int height, int width) {
+        for (int i = 0; i < height; ++i) {
+            uint64_t* row = this->getRow(i);
+            
+            for (int bit = 1; bit < width + 1;) {
+                int end = std::min(width + 1, (bit/64 + 1)*64);
+                uint64_t mask = SpatialMemory::mask(bit % 64, end - (bit/64)*64);
+                
+                row[bit/64] |= mask;
+                bit = end;
+            }
+        }
+    }
+    
+    /**
+     * Check cell (i, j).
+     * 
+     * @param int i
+     * @param int j
+     * @return
+     */
+    inline bool test(int i, int j) const {
+        return (this->getRow(i)[(j + 1)/64] >> ((j + 1) % 64)) & 1;
+    }
+    
+    /**
+     * Set cell (i, j) to be checked again.
+     * 
+     * @param int i
+     * @param int j
+     */
+    inline void set(int i, int j) {
+        this->getRow(i)[(j + 1)/64] |= ((uint64_t) 1) << ((j + 1) % 64);
+    }
+    
+    /**
+     * Cell (i, j) does not need to be checked again.
+     * 
+     * @param int i
+     * @param int j
+     */
+    inline void reset(int i, int j) {
+        this->getRow(i)[(j + 1)/64] &= ~(((uint64_t) 1) << ((j + 1) % 64));
+    }
+    
+    /**
+     * Find the first set cell (i, k) with j <= k < end. As the bits are read again
+     * on every call, cells set behind the previous cell within the sweep are found.
+     * 
+     * @param int i
+     * @param int j
+     * @param int end
+     * @return the column of the cell or end if there is none
+     */
+    inline int next(int i, int j, int end) const {
+        if (j >= end) {
+            return end;
+        }
+        
+        const uint64_t* row = this->getRow(i);
+        
+        int index = (j + 1)/64;
+        int lastIndex = end/64;
+        uint64_t word = row[index] & ~SpatialMemory::mask(0, (j + 1) % 64);
+        
+        while (word == 0) {
+            ++index;
+            
+            if (index > lastIndex) {
+                return end;
+            }
+            
+            word = row[index];
+        }
+        
+        int k = index*64 + SpatialMemory::countTrailingZeros(word) - 1;
+        return k < end ? k : end;
+    }
+    
+    /**
+     * Find the first cell (i, k) with j <= k < end which is set both in this
+     * and in the other bitset of the same size.
+     * 
+     * @param int i
+     * @param int j
+     * @param int end
+     * @param SpatialMemory other
+     * @return the column of the cell or end if there is none
+     */
+    inline int next(int i, int j, int end, const SpatialMemory &other) const {
+        if (j >= end) {
+            return end;
+        }
+        
+        const uint64_t* row = this->getRow(i);
+        const uint64_t* otherRow = other.getRow(i);
+        
+        int index = (j + 1)/64;
+        int lastIndex = end/64;
+        uint64_t word = row[index] & otherRow[index] & ~SpatialMemory::mask(0, (j + 1) % 64);
+        
+        while (word == 0) {
+            ++index;
+            
+            if (index > lastIndex) {
+                return end;
+            }
+            
+            word = row[index] & otherRow[index];
+        }
+        
+        int k = index*64 + SpatialMemory::countTrailingZeros(word) - 1;
+        return k < end ? k : end;
+    }
+    
+private:
+    
+    /**
+     * Get the words of row i.
+     * 
+     * @param int i
+     * @return
+     */
+    inline uint64_t* getRow(int i) {
+        return &this->words[(i + 1)*this->wordsPerRow];
+    }
+    
+    /**
+     * Get the words of row i.
+     * 
+     * @param int i
+     * @return
+     */
+    inline const uint64_t* getRow(int i) const {
+        return &this->words[(i + 1)*this->wordsPerRow];
+    }
+    
+    /**
+     * Mask of the bits from (inclusive) to end (exclusive) within a word.
+     * 
+     * @param int from
+     * @param int end
+     * @return
+     */
+    static inline uint64_t mask(int from, int end) {
+        uint64_t upper = (end >= 64) ? ~((uint64_t) 0) : ((((uint64_t) 1) << end) - 1);
+        uint64_t lower = (((uint64_t) 1) << from) - 1;
+        
+        return upper & ~lower;
+    }
+    
+    /**
+     * Index of the lowest set bit, word may not be zero.
+     * 
+     * @param uint64_t word
+     * @return
+     */
+    static inline int countTrailingZeros(uint64_t word) {
+        #if defined(__GNUC__)
+            return __builtin_ctzll(word);
+        #elif defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanForward64(&index, word);
+            return (int) index;
+        #else
+            int count = 0;
+            while ((word & 1) == 0) {
+                word >>= 1;
+                ++count;
+            }
+            
+            return count;
+        #endif
+    }
+    
+    /**
+     * Number of words per row.
+     */
+    int wordsPerRow;
+    
+    /**
+     * The bits, row by row.
+     */
+    std::vector<uint64_t> words;
+};
+
+#endif	/* SEEDS_REVISED_SPATIAL_MEMORY_H */
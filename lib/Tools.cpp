@@ -65,8 +65,16 @@
 #include "SeedsRevised.h"
 
 cv::Mat Draw::contourImage(int** labels, const cv::Mat &image, int* bgr) {
+    cv::Mat newImage;
+    Draw::contourImage(labels, image, bgr, newImage);
     
-    cv::Mat newImage = image.clone();
+    return newImage;
+}
+
+void Draw::contourImage(int** labels, const cv::Mat &image, int* bgr, cv::Mat &output) {
+    
+    // Does nothing if drawing in place.
+    image.copyTo(output);
     
     int label = 0;
     int labelTop = -1;
@@ -74,8 +82,10 @@ cv::Mat Draw::contourImage(int** labels, const cv::Mat &image, int* bgr) {
     int labelLeft = -1;
     int labelRight = -1;
     
-    for (int i = 0; i < newImage.rows; i++) {
-        for (int j = 0; j < newImage.cols; j++) {
+    for (int i = 0; i < output.rows; i++) {
+        cv::Vec3b* row = output.ptr<cv::Vec3b>(i);
+        
+        for (int j = 0; j < output.cols; j++) {
             
             label = labels[i][j];
             
@@ -85,7 +95,7 @@ cv::Mat Draw::contourImage(int** labels, const cv::Mat &image, int* bgr) {
             }
             
             labelBottom = label;
-            if (i < newImage.rows - 1) {
+            if (i < output.rows - 1) {
                 labelBottom = labels[i + 1][j];
             }
             
@@ -95,68 +105,173 @@ cv::Mat Draw::contourImage(int** labels, const cv::Mat &image, int* bgr) {
             }
             
             labelRight = label;
-            if (j < newImage.cols - 1) {
+            if (j < output.cols - 1) {
                 labelRight = labels[i][j + 1];
             }
             
             if (label != labelTop || label != labelBottom || label!= labelLeft || label != labelRight) {
-                newImage.at<cv::Vec3b>(i, j)[0] = bgr[0];
-                newImage.at<cv::Vec3b>(i, j)[1] = bgr[1];
-                newImage.at<cv::Vec3b>(i, j)[2] = bgr[2];
+                row[j][0] = bgr[0];
+                row[j][1] = bgr[1];
+                row[j][2] = bgr[2];
+            }
+        }
+    }
+}
+
+/**
+ * Accumulates the color sums and pixel counts per label for a range of row stripes,
+ * each stripe has its own sums which are reduced afterwards.
+ */
+class MeanImageAccumulateInvoker : public cv::ParallelLoopBody {
+public:
+    
+    MeanImageAccumulateInvoker(int** labels, const cv::Mat &image, int numberOfLabels, int numberOfStripes, int* sums)
+            : labels(labels), image(image), numberOfLabels(numberOfLabels), numberOfStripes(numberOfStripes), sums(sums) {
+        
+    }
+    
+    void operator()(const cv::Range &range) const {
+        for (int stripe = range.start; stripe < range.end; ++stripe) {
+            int* stripeSums = this->sums + 4*this->numberOfLabels*stripe;
+            
+            int iStart = (stripe*this->image.rows)/this->numberOfStripes;
+            int iEnd = ((stripe + 1)*this->image.rows)/this->numberOfStripes;
+            
+            for (int i = iStart; i < iEnd; ++i) {
+                const cv::Vec3b* row = this->image.ptr<cv::Vec3b>(i);
+                
+                for (int j = 0; j < this->image.cols; ++j) {
+                    int* sum = stripeSums + 4*this->labels[i][j];
+                    
+                    sum[0] += row[j][0];
+                    sum[1] += row[j][1];
+                    sum[2] += row[j][2];
+                    ++sum[3];
+                }
+            }
+        }
+    }
+    
+private:
+    
+    int** labels;
+    const cv::Mat &image;
+    int numberOfLabels;
+    int numberOfStripes;
+    int* sums;
+};
+
+/**
+ * Colors a range of rows using the mean colors per label.
+ */
+class MeanImagePaintInvoker : public cv::ParallelLoopBody {
+public:
+    
+    MeanImagePaintInvoker(int** labels, cv::Mat &newImage, const cv::Vec3b* colors)
+            : labels(labels), newImage(newImage), colors(colors) {
+        
+    }
+    
+    void operator()(const cv::Range &range) const {
+        for (int i = range.start; i < range.end; ++i) {
+            cv::Vec3b* row = this->newImage.ptr<cv::Vec3b>(i);
+            
+            for (int j = 0; j < this->newImage.cols; ++j) {
+                row[j] = this->colors[this->labels[i][j]];
             }
         }
     }
     
+private:
+    
+    int** labels;
+    cv::Mat &newImage;
+    const cv::Vec3b* colors;
+};
+
+cv::Mat Draw::meanImage(int** labels, const cv::Mat &image) {
+    cv::Mat newImage;
+    Draw::meanImage(labels, image, newImage);
+    
     return newImage;
 }
 
-cv::Mat Draw::meanImage(int** labels, const cv::Mat &image) {
+void Draw::meanImage(int** labels, const cv::Mat &image, cv::Mat &output) {
     assert(image.channels() == 3);
     
-    cv::Mat newImage = image.clone();
-    int numberOfSuperpixels = Integrity::countSuperpixels(labels, newImage.rows, newImage.cols);
+    int maxLabel = 0;
+    for (int i = 0; i < image.rows; i++) {
+        for (int j = 0; j < image.cols; j++) {
+            assert(labels[i][j] >= 0);
+            
+            if (labels[i][j] > maxLabel) {
+                maxLabel = labels[i][j];
+            }
+        }
+    }
     
-    int meanB = 0;
-    int meanG = 0;
-    int meanR = 0;
-    int count = 0;
+    int numberOfLabels = maxLabel + 1;
+    int numberOfStripes = std::max(1, std::min(cv::getNumThreads(), image.rows));
+    
+    // Contiguous sums of blue, green, red and the pixel count per label and stripe.
+    std::vector<int> sums(4*numberOfLabels*numberOfStripes, 0);
+    cv::parallel_for_(cv::Range(0, numberOfStripes), MeanImageAccumulateInvoker(labels, image, numberOfLabels, numberOfStripes, &sums[0]));
     
-    for (int label = 0; label < numberOfSuperpixels; label++) {
-        meanB = 0;
-        meanG = 0;
-        meanR = 0;
-        count = 0;
+    std::vector<cv::Vec3b> colors(numberOfLabels);
+    for (int label = 0; label < numberOfLabels; ++label) {
+        int sum[4] = {0, 0, 0, 0};
         
-        for (int i = 0; i < newImage.rows; i++) {
-            for (int j = 0; j < newImage.cols; j++) {
-                if (labels[i][j] == label) {
-                    meanB += image.at<cv::Vec3b>(i, j)[0];
-                    meanG += image.at<cv::Vec3b>(i, j)[1];
-                    meanR += image.at<cv::Vec3b>(i, j)[2];
-                    
-                    count++;
-                }
+        for (int stripe = 0; stripe < numberOfStripes; ++stripe) {
+            for (int k = 0; k < 4; ++k) {
+                sum[k] += sums[4*(numberOfLabels*stripe + label) + k];
             }
         }
         
-        if (count > 0) {
-            meanB = (int) meanB/count;
-            meanG = (int) meanG/count;
-            meanR = (int) meanR/count;
+        if (sum[3] > 0) {
+            colors[label] = cv::Vec3b(sum[0]/sum[3], sum[1]/sum[3], sum[2]/sum[3]);
         }
+    }
+    
+    // The image has been read completely, so it may be overwritten if drawing in place.
+    output.create(image.rows, image.cols, image.type());
+    cv::parallel_for_(cv::Range(0, output.rows), MeanImagePaintInvoker(labels, output, &colors[0]));
+}
+
+cv::Mat Draw::meanImage(const SEEDSRevisedMeanPixels &seeds, const cv::Mat &image) {
+    cv::Mat newImage;
+    Draw::meanImage(seeds, image, newImage);
+    
+    return newImage;
+}
+
+void Draw::meanImage(const SEEDSRevisedMeanPixels &seeds, const cv::Mat &image, cv::Mat &output) {
+    assert(image.channels() == 3);
+    
+    // For BGR and LAB, the algorithm works on the Lab image; the means of
+    // other color spaces are not converted back. For grayscale images, only
+    // one channel is tracked.
+    if (seeds.getNumberOfChannels() != 3 
+            || (seeds.getColorSpace() != SEEDSRevised::BGR && seeds.getColorSpace() != SEEDSRevised::LAB)) {
+        Draw::meanImage(seeds.getLabelArray(), image, output);
+        return;
+    }
+    
+    int numberOfLabels = seeds.getNumberOfSuperpixels();
+    cv::Mat colors(1, numberOfLabels, CV_8UC3);
+    
+    float color[3];
+    for (int label = 0; label < numberOfLabels; ++label) {
+        seeds.getMeanColor(label, color);
         
-        for (int i = 0; i < newImage.rows; i++) {
-            for (int j = 0; j < newImage.cols; j++) {
-                if (labels[i][j] == label) {
-                    newImage.at<cv::Vec3b>(i, j)[0] = meanB;
-                    newImage.at<cv::Vec3b>(i, j)[1] = meanG;
-                    newImage.at<cv::Vec3b>(i, j)[2] = meanR;
-                }
-            }
+        for (int k = 0; k < 3; ++k) {
+            colors.at<cv::Vec3b>(0, label)[k] = (uchar) (color[k] + 0.5f);
         }
     }
     
-    return newImage;
+    cv::cvtColor(colors, colors, SEEDS_REVISED_OPENCV_Lab2BGR);
+    
+    output.create(image.rows, image.cols, image.type());
+    cv::parallel_for_(cv::Range(0, output.rows), MeanImagePaintInvoker(seeds.getLabelArray(), output, colors.ptr<cv::Vec3b>(0)));
 }
 
 cv::Mat Draw::labelImage(int** labels, const cv::Mat &image) {
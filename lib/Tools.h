@@ -69,6 +69,7 @@
 #ifndef SEEDS_REVISED_TOOLS_H
 #define	SEEDS_REVISED_TOOLS_H
 
+class SEEDSRevisedMeanPixels;
         
 /**
  * Class Integrity provides some helper to check the integrity of the generated
@@ -156,6 +157,19 @@ public:
      * @return 
      */
     static cv::Mat contourImage(int** labels, const cv::Mat &image, int* bgr);
+    
+    /**
+     * Draws contours around superpixels into the given output image, which is
+     * only allocated if its size or type does not match the image. Thus, the
+     * output may wrap a buffer of the caller or be the image itself, in which
+     * case the contours are drawn in place.
+     * 
+     * @param int** labels superpixel labels (first dimension is x-axis)
+     * @param cv::Mat image original image
+     * @param int* rgb rgb color of contours
+     * @param cv::Mat output
+     */
+    static void contourImage(int** labels, const cv::Mat &image, int* bgr, cv::Mat &output);
 
     /**
      * Draws a colored label image where each label gets assigned a 
@@ -171,11 +185,49 @@ public:
      * Compute a mean image, that is every superpixel is colored 
      * according to its mean color.
      * 
+     * The sums are accumulated in a single pass over the image, both the
+     * accumulation and the coloring are parallelized over rows.
+     * 
      * @param int** labels superpixel labels (first dimension is x-axis)
      * @param image original image
      * @return 
      */
     static cv::Mat meanImage(int** labels, const cv::Mat &image);
+    
+    /**
+     * Compute a mean image into the given output image, which is only allocated
+     * if its size or type does not match the image; it may be the image itself.
+     * 
+     * @param int** labels superpixel labels (first dimension is x-axis)
+     * @param image original image
+     * @param cv::Mat output
+     */
+    static void meanImage(int** labels, const cv::Mat &image, cv::Mat &output);
+    
+    /**
+     * Compute a mean image reusing the mean colors tracked by SEEDSRevisedMeanPixels
+     * during the pixel updates, such that the image needs not to be accumulated again.
+     * 
+     * The means are tracked in Lab and converted back to BGR, so the colors may
+     * slightly differ from the above method. Falls back to the above method if
+     * the color space used is neither BGR nor LAB, or if the algorithm ran on
+     * a grayscale image.
+     * 
+     * @param SEEDSRevisedMeanPixels seeds after iterate
+     * @param image original image
+     * @return 
+     */
+    static cv::Mat meanImage(const SEEDSRevisedMeanPixels &seeds, const cv::Mat &image);
+    
+    /**
+     * Compute a mean image from the tracked mean colors into the given output
+     * image, which is only allocated if its size or type does not match the image.
+     * 
+     * @param SEEDSRevisedMeanPixels seeds after iterate
+     * @param image original image
+     * @param cv::Mat output
+     */
+    static void meanImage(const SEEDSRevisedMeanPixels &seeds, const cv::Mat &image, cv::Mat &output);
 
 };
 